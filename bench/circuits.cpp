@@ -0,0 +1,134 @@
+// Reports how long parsing, sorting and analysis take on every family of circuits in generators.h,
+// and how many ticks per second each engine simulates. Meant for an optimised build without
+// sanitizers (see CMakeLists.txt), to catch regressions and compare the engines.
+//
+// Syntax: bench_circuits [scale=1] [threads=1]
+#include "analysis.h"
+#include "bitparallel.h"
+#include "generators.h"
+#include "kernels.h"
+#include "parser.h"
+#include "simulation.h"
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Runs `f` for at least a fifth of a second, doubling the number of runs until it does, and
+// returns the seconds per run
+static double time_per_run(const std::function<void()> &f) {
+	for (uint64_t runs = 1;; runs *= 2) {
+		auto start = Clock::now();
+		for (uint64_t i = 0; i < runs; i++)
+			f();
+		double seconds = seconds_since(start);
+		if (seconds >= 0.2)
+			return seconds / runs;
+	}
+}
+
+// Discards what is written to it, like /dev/null
+class NullBuffer : public std::streambuf {
+  protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+};
+
+template <class Circuit>
+static double ticks_per_second(Circuit &ckt, const std::vector<std::vector<TruthValue>> &vectors) {
+	return vectors.size() / time_per_run([&]() {
+		       for (const std::vector<TruthValue> &inputs : vectors)
+			       ckt.evaluate(inputs);
+	       });
+}
+
+static void benchmark(const std::string &name, const std::string &netlist, size_t threads) {
+	// A parser can only be sorted once, so every run parses and sorts
+	double parse = 0, sort = 0;
+	size_t runs = 0;
+	ast::Module module;
+	for (; parse + sort < 0.2; runs++) {
+		auto start = Clock::now();
+		FileParser parser(std::string_view(netlist), threads);
+		parse += seconds_since(start);
+		start = Clock::now();
+		module = parser.finalize();
+		sort += seconds_since(start);
+	}
+	std::cout << name << ": " << module.assignments.size() << " assignments, "
+	          << module.state_size() << " flip-flops" << std::endl;
+	std::cout << "\tparsing: " << parse * 1e3 / runs << " ms, sorting: " << sort * 1e3 / runs
+	          << " ms" << std::endl;
+
+	NullBuffer null;
+	std::streambuf *console = std::cout.rdbuf(&null);
+	double analysis = time_per_run([&]() { analysis::run(module, threads); });
+	std::cout.rdbuf(console);
+	std::cout << "\tanalysis: " << analysis * 1e3 << " ms" << std::endl;
+
+	std::mt19937_64 rng(42);
+	std::vector<std::vector<TruthValue>> vectors(64, std::vector<TruthValue>(module.input_size()));
+	for (std::vector<TruthValue> &vector : vectors)
+		for (TruthValue &value : vector)
+			value = bool(rng() & 1);
+
+	bytecode::Program program = bytecode::compile(module);
+	bytecode::optimize(program);
+	simulation::Implementation impl;
+	simulation::Circuit interpreted(module, impl);
+	simulation::CompiledCircuit compiled(program, impl);
+	ThreadPool pool(threads);
+	if (pool.size() > 1)
+		compiled.parallelize(pool);
+	simulation::EventDrivenCircuit event_driven(program, impl);
+	std::cout << "\tticks/s: interpreted " << ticks_per_second(interpreted, vectors)
+	          << ", compiled " << ticks_per_second(compiled, vectors) << ", event-driven "
+	          << ticks_per_second(event_driven, vectors);
+
+	// Only circuits without flip-flops can be simulated a vector per lane
+	if (module.state_size() == 0) {
+		std::string text;
+		for (size_t i = 0; i < 4096; i++) {
+			for (TruthValue value : vectors[i % vectors.size()])
+				text += value.toChar();
+			text += '\n';
+		}
+		std::ostream out(&null);
+		double seconds = time_per_run([&]() {
+			vectorio::VectorReader reader(text);
+			vectorio::ResultWriter writer(out, vectorio::Format::TEXT, module.output_size());
+			bitparallel::run(program, kernels::widest(), reader, writer, threads);
+		});
+		std::cout << ", bit-parallel " << 4096 / seconds << " (with the text I/O)";
+	}
+	std::cout << std::endl;
+}
+
+int main(int argc, char **argv) {
+	size_t scale = argc > 1 ? std::stoul(argv[1]) : 1;
+	size_t threads = argc > 2 ? std::stoul(argv[2]) : 1;
+
+	std::pair<std::string, std::string> circuits[] = {
+	    {"ripple-carry adder", generators::ripple_carry_adder(1024 * scale)},
+	    {"carry-lookahead adder", generators::carry_lookahead_adder(1024 * scale)},
+	    {"array multiplier", generators::array_multiplier(32 * scale)},
+	    {"LFSR", generators::lfsr(4096 * scale)},
+	    {"random DAG", generators::random_dag(256, 32 * scale, 256, 3, 42)},
+	    {"pipeline", generators::pipeline(1024 * scale, 16)},
+	};
+	for (const auto &[name, netlist] : circuits) {
+		try {
+			benchmark(name, netlist, threads);
+		} catch (std::string &e) {
+			std::cerr << "Failed to benchmark the " << name << ": " << e << std::endl;
+			return 1;
+		}
+	}
+}
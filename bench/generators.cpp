@@ -0,0 +1,205 @@
+#include "generators.h"
+#include <algorithm>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+	// Collects the ports while the body is written
+	class Netlist {
+		std::string name;
+		std::vector<std::string> inputs, outputs;
+		std::string body;
+		bool clocked = false;
+
+	  public:
+		explicit Netlist(std::string name) : name(std::move(name)) {}
+
+		std::string input(const std::string &signal) {
+			inputs.push_back(signal);
+			return signal;
+		}
+		std::string assign(const std::string &signal, const std::string &expression) {
+			outputs.push_back(signal);
+			body += "\tassign " + signal + " = " + expression + "\n";
+			return signal;
+		}
+		std::string flipflop(size_t index, const std::string &expression) {
+			std::string signal = "FF" + std::to_string(index);
+			clocked = true;
+			body += "\t" + signal + " = " + expression + "\n";
+			return signal;
+		}
+
+		std::string str() const {
+			std::string out = "module " + name + " (\n";
+			if (clocked)
+				out += "\tclk\n";
+			for (auto [keyword, ports] : {std::pair{"input", &inputs}, {"output", &outputs}}) {
+				out += "\t"s + keyword;
+				for (size_t i = 0; i < ports->size(); i++)
+					out += (i ? ", " : " ") + (*ports)[i];
+				out += "\n";
+			}
+			return out + ");\n" + body + "endmodule\n";
+		}
+	};
+} // namespace
+
+static std::string gate(const std::string &lhs, const char *op, const std::string &rhs) {
+	return "(" + lhs + " " + op + " " + rhs + ")";
+}
+
+// Returns the sum and the carry; the signals are named after `suffix`
+static std::pair<std::string, std::string> full_adder(Netlist &netlist, const std::string &a,
+                                                      const std::string &b,
+                                                      const std::string &carry,
+                                                      const std::string &suffix) {
+	std::string p = netlist.assign("p" + suffix, gate(a, "XOR", b));
+	return {netlist.assign("s" + suffix, gate(p, "XOR", carry)),
+	        netlist.assign("c" + suffix, gate(a, "AND", b) + " OR " + gate(p, "AND", carry))};
+}
+
+static std::pair<std::string, std::string> half_adder(Netlist &netlist, const std::string &a,
+                                                      const std::string &b,
+                                                      const std::string &suffix) {
+	return {netlist.assign("s" + suffix, gate(a, "XOR", b)),
+	        netlist.assign("c" + suffix, gate(a, "AND", b))};
+}
+
+static std::vector<std::string> inputs(Netlist &netlist, const std::string &prefix, size_t count) {
+	std::vector<std::string> signals;
+	for (size_t i = 0; i < count; i++)
+		signals.push_back(netlist.input(prefix + std::to_string(i)));
+	return signals;
+}
+
+std::string generators::ripple_carry_adder(size_t bits) {
+	Netlist netlist("RIPPLE_CARRY_ADDER");
+	std::vector<std::string> a = inputs(netlist, "a", bits), b = inputs(netlist, "b", bits);
+	std::string carry = netlist.input("cin");
+	for (size_t i = 0; i < bits; i++)
+		carry = full_adder(netlist, a[i], b[i], carry, std::to_string(i)).second;
+	return netlist.str();
+}
+
+std::string generators::carry_lookahead_adder(size_t bits) {
+	Netlist netlist("CARRY_LOOKAHEAD_ADDER");
+	std::vector<std::string> a = inputs(netlist, "a", bits), b = inputs(netlist, "b", bits);
+	std::string carry = netlist.input("cin");
+	std::vector<std::string> generate, propagate;
+	for (size_t i = 0; i < bits; i++) {
+		generate.push_back(netlist.assign("g" + std::to_string(i), gate(a[i], "AND", b[i])));
+		propagate.push_back(netlist.assign("p" + std::to_string(i), gate(a[i], "XOR", b[i])));
+	}
+	for (size_t block = 0; block < bits; block += 4) {
+		std::string block_carry = carry;
+		for (size_t i = block; i < std::min(block + 4, bits); i++) {
+			netlist.assign("s" + std::to_string(i), gate(propagate[i], "XOR", carry));
+			// c[i] = g[i] OR p[i] g[i - 1] OR ... OR p[i] ... p[block] carry
+			std::string expression = generate[i], product = propagate[i];
+			for (size_t j = i; j-- > block;) {
+				expression += " OR " + gate(product, "AND", generate[j]);
+				product += " AND " + propagate[j];
+			}
+			expression += " OR " + gate(product, "AND", block_carry);
+			carry = netlist.assign("c" + std::to_string(i), expression);
+		}
+	}
+	return netlist.str();
+}
+
+std::string generators::array_multiplier(size_t bits) {
+	Netlist netlist("ARRAY_MULTIPLIER");
+	std::vector<std::string> a = inputs(netlist, "a", bits), b = inputs(netlist, "b", bits);
+	auto partial_product = [&](size_t row, size_t column) {
+		return netlist.assign("pp" + std::to_string(row) + "_" + std::to_string(column),
+		                      gate(a[column], "AND", b[row]));
+	};
+
+	// The bits of the sum of the rows so far
+	std::vector<std::string> sum(2 * bits);
+	for (size_t column = 0; column < bits; column++)
+		sum[column] = partial_product(0, column);
+	for (size_t row = 1; row < bits; row++) {
+		std::string carry;
+		for (size_t column = 0; column < bits; column++) {
+			std::string suffix = std::to_string(row) + "_" + std::to_string(column);
+			std::string &bit = sum[row + column];
+			std::string product = partial_product(row, column);
+			// The first column has no carry, and the last one adds to no previous row
+			if (bit.empty())
+				std::swap(bit, carry);
+			if (bit.empty())
+				bit = product;
+			else if (carry.empty())
+				std::tie(bit, carry) = half_adder(netlist, bit, product, suffix);
+			else
+				std::tie(bit, carry) = full_adder(netlist, bit, product, carry, suffix);
+		}
+		sum[row + bits] = carry;
+	}
+	for (size_t i = 0; i < sum.size(); i++)
+		if (!sum[i].empty())
+			netlist.assign("m" + std::to_string(i), sum[i]);
+	return netlist.str();
+}
+
+std::string generators::lfsr(size_t bits) {
+	Netlist netlist("LFSR");
+	std::string rst = netlist.input("rst");
+	std::set<size_t> taps = {bits - 1, bits * 3 / 4, bits / 2, bits / 4};
+	std::string feedback;
+	for (size_t tap : taps)
+		feedback += (feedback.empty() ? "FF" : " XOR FF") + std::to_string(tap);
+	netlist.flipflop(0, rst + " OR (" + feedback + ")");
+	for (size_t i = 1; i < bits; i++)
+		netlist.flipflop(i, gate("NOT " + rst, "AND", "FF" + std::to_string(i - 1)));
+	for (size_t i = 0; i < bits; i++)
+		netlist.assign("q" + std::to_string(i), "FF" + std::to_string(i));
+	return netlist.str();
+}
+
+std::string generators::random_dag(size_t inputs, size_t depth, size_t width, size_t fanin,
+                                   uint64_t seed) {
+	static const char *operators[] = {"AND", "OR", "XOR", "NAND", "NOR", "XNOR"};
+	std::mt19937_64 rng(seed);
+	Netlist netlist("RANDOM_DAG");
+	std::vector<std::string> signals = ::inputs(netlist, "i", inputs);
+	size_t previous = 0; // The first signal of the previous level
+	for (size_t level = 1; level <= depth; level++) {
+		size_t first = signals.size();
+		for (size_t i = 0; i < width; i++) {
+			std::string expression = signals[previous + rng() % (first - previous)];
+			const char *op = operators[rng() % 6];
+			for (size_t j = 1; j < fanin; j++)
+				expression += " "s + op + " " + signals[rng() % first];
+			if (fanin == 1 || rng() % 8 == 0)
+				expression = "NOT (" + expression + ")";
+			std::string name = "g" + std::to_string(level) + "_" + std::to_string(i);
+			signals.push_back(netlist.assign(name, expression));
+		}
+		previous = first;
+	}
+	return netlist.str();
+}
+
+std::string generators::pipeline(size_t width, size_t stages) {
+	static const char *operators[] = {"XOR", "NAND", "XNOR", "NOR"};
+	Netlist netlist("PIPELINE");
+	std::vector<std::string> signals = inputs(netlist, "d", width);
+	for (size_t stage = 0; stage < stages; stage++) {
+		std::vector<std::string> next;
+		for (size_t i = 0; i < width; i++)
+			next.push_back(netlist.flipflop(stage * width + i,
+			                                gate(signals[i], operators[(stage + i) % 4],
+			                                     signals[(i + 1) % width])));
+		signals = std::move(next);
+	}
+	for (size_t i = 0; i < width; i++)
+		netlist.assign("q" + std::to_string(i), signals[i]);
+	return netlist.str();
+}
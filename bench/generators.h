@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/* Parameterised circuits for the benchmarks, in the Verilog subset of the parser. Assignments can
+ * only write outputs and flip-flops, so every intermediate signal is an output too.
+ */
+namespace generators {
+	// Sums two `bits`-bit numbers and a carry, with a chain of full adders
+	std::string ripple_carry_adder(size_t bits);
+	// Like ripple_carry_adder, but the carries of every 4-bit block are computed in two levels of
+	// logic from the carry into the block
+	std::string carry_lookahead_adder(size_t bits);
+	// Multiplies two `bits`-bit numbers, adding one row of partial products at a time
+	std::string array_multiplier(size_t bits);
+	// A Fibonacci LFSR of `bits` flip-flops. `rst` loads 1 into the first flip-flop and 0 into the
+	// others, since the flip-flops start as X.
+	std::string lfsr(size_t bits);
+	// `depth` levels of `width` gates, each reading `fanin` signals: one from the previous level,
+	// and the others from any earlier level or the inputs
+	std::string random_dag(size_t inputs, size_t depth, size_t width, size_t fanin, uint64_t seed);
+	// `stages` ranks of `width` flip-flops, each rank mixing pairs of signals of the previous one
+	std::string pipeline(size_t width, size_t stages);
+} // namespace generators
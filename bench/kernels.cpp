@@ -0,0 +1,78 @@
+// Reports how many vectors per second each bit-parallel kernel simulates on a random circuit.
+//
+// Syntax: bench_kernels [gates] [inputs]
+#include "bitparallel.h"
+#include "kernels.h"
+#include "parser.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Every gate reads two random earlier signals, and every signal is an output.
+static ast::Module random_module(size_t gates, size_t inputs, std::mt19937_64 &rng) {
+	static const char *operators[] = {"AND", "OR", "XOR", "NAND", "NOR", "XNOR"};
+	std::stringstream netlist;
+	netlist << "module BENCHMARK (\n\tinput";
+	for (size_t i = 0; i < inputs; i++)
+		netlist << (i ? ", " : " ") << "i" << i;
+	netlist << "\n\toutput";
+	for (size_t i = 0; i < gates; i++)
+		netlist << (i ? ", " : " ") << "g" << i;
+	netlist << "\n);\n";
+
+	auto signal = [&](size_t gate) {
+		size_t index = rng() % (inputs + gate);
+		return index < inputs ? "i" + std::to_string(index)
+		                      : "g" + std::to_string(index - inputs);
+	};
+	for (size_t i = 0; i < gates; i++) {
+		netlist << "\tassign g" << i << " = ";
+		if (rng() % 8 == 0)
+			netlist << "NOT " << signal(i) << "\n";
+		else
+			netlist << signal(i) << " " << operators[rng() % 6] << " " << signal(i) << "\n";
+	}
+	netlist << "endmodule\n";
+	return FileParser(netlist).finalize();
+}
+
+int main(int argc, char **argv) {
+	size_t gates = argc > 1 ? std::stoul(argv[1]) : 10000;
+	size_t inputs = argc > 2 ? std::stoul(argv[2]) : 64;
+	std::mt19937_64 rng(42);
+
+	ast::Module module;
+	try {
+		module = random_module(gates, inputs, rng);
+	} catch (std::string &e) {
+		std::cerr << "Failed to build the circuit: " << e << std::endl;
+		return 1;
+	}
+	bytecode::Program program = bytecode::compile(module);
+	std::cout << "Circuit: " << inputs << " inputs, " << program.code.size() << " instructions"
+	          << std::endl;
+
+	for (const kernels::Kernel &kernel : kernels::available()) {
+		bitparallel::Buffer buffer(program.slot_count, kernel.words);
+		for (size_t i = 0; i < inputs; i++)
+			for (size_t lane = 0; lane < kernel.lanes(); lane++)
+				buffer.set(program.slot_of(ast::Input{i}), lane, bool(rng() & 1));
+
+		// Run for at least a second, doubling the number of ticks until we do
+		using Clock = std::chrono::steady_clock;
+		double seconds = 0;
+		uint64_t ticks;
+		for (ticks = 1; seconds < 1; ticks *= 2) {
+			auto start = Clock::now();
+			for (uint64_t i = 0; i < ticks; i++)
+				kernel.execute(program, buffer.data());
+			seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		}
+		ticks /= 2;
+
+		double vectors_per_second = double(ticks) * kernel.lanes() / seconds;
+		std::cout << kernel.name << " (" << kernel.lanes() << " lanes): " << vectors_per_second
+		          << " vectors/s" << std::endl;
+	}
+}
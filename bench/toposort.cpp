@@ -0,0 +1,72 @@
+// Reports how long parsing and sorting take on random netlists of growing size, to check that they
+// scale linearly.
+//
+// Syntax: bench_toposort [max assignments=1000000] [threads=1]
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+// Every gate reads two random earlier signals, and the assignments are shuffled so that they must
+// be sorted. A flip-flop every 64 gates feeds back into the later gates.
+static std::string random_netlist(size_t gates, std::mt19937_64 &rng) {
+	static const char *operators[] = {"AND", "OR", "XOR", "NAND", "NOR", "XNOR"};
+	const size_t inputs = 64, flipflops = std::min<size_t>(gates / 64, 60000);
+	std::stringstream netlist;
+	netlist << "module BENCHMARK (\n\tclk\n\tinput";
+	for (size_t i = 0; i < inputs; i++)
+		netlist << (i ? ", " : " ") << "i" << i;
+	netlist << "\n\toutput";
+	for (size_t i = 0; i < gates; i++)
+		netlist << (i ? ", " : " ") << "g" << i;
+	netlist << "\n);\n";
+
+	auto signal = [&](size_t gate) {
+		size_t index = rng() % (inputs + flipflops + gate);
+		if (index < inputs)
+			return "i" + std::to_string(index);
+		if (index < inputs + flipflops)
+			return "FF" + std::to_string(index - inputs);
+		return "g" + std::to_string(index - inputs - flipflops);
+	};
+	std::vector<std::string> assignments;
+	for (size_t i = 0; i < gates; i++)
+		assignments.push_back("\tassign g" + std::to_string(i) + " = " + signal(i) + " " +
+		                      operators[rng() % 6] + " " + signal(i) + "\n");
+	for (size_t i = 0; i < flipflops; i++)
+		assignments.push_back("\tFF" + std::to_string(i) + " = " + signal(gates) + "\n");
+	std::shuffle(assignments.begin(), assignments.end(), rng);
+	for (const std::string &assignment : assignments)
+		netlist << assignment;
+	netlist << "endmodule\n";
+	return netlist.str();
+}
+
+int main(int argc, char **argv) {
+	size_t max_gates = argc > 1 ? std::stoul(argv[1]) : 1000000;
+	size_t threads = argc > 2 ? std::stoul(argv[2]) : 1;
+	std::mt19937_64 rng(42);
+
+	using Clock = std::chrono::steady_clock;
+	for (size_t gates = 10000; gates <= max_gates; gates *= 10) {
+		std::stringstream netlist(random_netlist(gates, rng));
+		try {
+			auto start = Clock::now();
+			FileParser parser(netlist, threads);
+			auto parsed = Clock::now();
+			ast::Module module = parser.finalize();
+			auto sorted = Clock::now();
+
+			double parse = std::chrono::duration<double>(parsed - start).count();
+			double sort = std::chrono::duration<double>(sorted - parsed).count();
+			std::cout << module.assignments.size() << " assignments: parsed in " << parse
+			          << " s, sorted in " << sort << " s (" << sort * 1e9 / gates
+			          << " ns per assignment)" << std::endl;
+		} catch (std::string &e) {
+			std::cerr << "Failed to build the circuit: " << e << std::endl;
+			return 1;
+		}
+	}
+}
@@ -0,0 +1,14 @@
+// A 3-bit counter that counts while a is 1 and resets to 0 while b is 1. Holding a at 1 takes its
+// flip-flops around the same 8 states over and over
+module COUNTER (
+	clk
+	input a, b
+	output q0, q1, q2
+);
+	assign q0 = FF0
+	assign q1 = FF1
+	assign q2 = FF2
+	FF0 = NOT b AND (FF0 XOR a)
+	FF1 = NOT b AND (FF1 XOR (a AND FF0))
+	FF2 = NOT b AND (FF2 XOR (a AND FF0 AND FF1))
+endmodule
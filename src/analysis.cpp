@@ -1,29 +1,58 @@
 #include "analysis.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace analysis;
 
-// Pop an operand, push it into the list of nodes, and return a pointer to the node
-Node *Implementation::fetch_operand(Engine::OperandStack &stack) {
-	nodes.push_front(pop(stack));
-	return &nodes.front();
+static size_t hash(const Node &node) {
+	size_t hash = std::hash<Token>()(node.token);
+	for (NodeId child : node.children)
+		hash = hash * 31 + child;
+	return hash;
+}
+
+// Doubles the hash table, keeping it at most half full
+void Implementation::grow() {
+	table.assign(std::max<size_t>(64, 2 * table.size()), NO_NODE);
+	size_t mask = table.size() - 1;
+	for (NodeId id = 0; id < nodes.size(); id++) {
+		size_t slot = hash(nodes[id]) & mask;
+		while (table[slot] != NO_NODE)
+			slot = (slot + 1) & mask;
+		table[slot] = id;
+	}
+}
+
+NodeId Implementation::intern(const Node &node) {
+	if (2 * (nodes.size() + 1) > table.size())
+		grow();
+	size_t mask = table.size() - 1;
+	size_t slot = hash(node) & mask;
+	for (; table[slot] != NO_NODE; slot = (slot + 1) & mask)
+		if (nodes[table[slot]] == node)
+			return table[slot];
+	table[slot] = nodes.size();
+	nodes.push_back(node);
+	return table[slot];
 }
 
 // Initializes the circuit state to simple, childless flip flops
-void Implementation::initialize(std::vector<Node> &state) {
+void Implementation::initialize(std::vector<NodeId> &state) {
 	for (size_t i = 0; i < state.size(); i++)
-		state[i] = {ast::Flipflop{i}, {}};
+		state[i] = intern({ast::Flipflop{i}});
 }
 
 // Just creates a new node with the appropriate children
 void Implementation::on_operator(ast::Operator astOperator, Engine::OperandStack &stack) {
 	switch (arity(astOperator)) {
 		case 1:
-			stack.push(Node{astOperator, {fetch_operand(stack)}});
+			stack.push(intern({astOperator, {pop(stack), NO_NODE}}));
 			break;
-		case 2:
-			stack.push(Node{astOperator, {fetch_operand(stack), fetch_operand(stack)}});
+		case 2: {
+			NodeId lhs = pop(stack);
+			stack.push(intern({astOperator, {lhs, pop(stack)}}));
 			break;
+		}
 	}
 }
 
@@ -34,71 +63,319 @@ std::string Path::toString(const ast::Module &module) const {
 	return ret;
 }
 
-// Walk the graph starting from this output
-void GraphWalker::walk_output(ast::Output output) {
-	current_lvalue_hierarchy.emplace_back(output);
-	walk(outputs[output.offset]);
-	current_lvalue_hierarchy.pop_back();
-}
-
-void GraphWalker::walk(const Node &node) {
-	Token token = node.token;
-	current_path.push_back(token);
-	std::visit([&](auto &&token) { return this->process(token); }, token);
-	for (Node *const child : node.children)
-		if (child != nullptr)
-			walk(*child);
-	current_path.pop_back();
-}
-
-// Add this input to the relevant logic cones, and update the shortest/longest path if needed
-void GraphWalker::process(ast::Input input) {
-	for (const ast::LValue &item : current_lvalue_hierarchy)
-		logic_cones[item].emplace(input.offset);
-	uint16_t length = current_path.size();
-	if (length > longest_path.length())
-		longest_path.path = std::vector(current_path.begin(), current_path.end());
-	if (length < shortest_path.length() || shortest_path.length() == 0)
-		shortest_path.path = std::vector(current_path.begin(), current_path.end());
-}
-
-// Visit this FF if it hasn't been visited so far
-void GraphWalker::process(ast::Flipflop ff) {
-	bool ff_was_visited = visited_ffs.find(ff) != visited_ffs.end();
-	if (ff_was_visited) {
-		LogicCone logic_cone = logic_cones[ff];
-		for (const ast::LValue &item : current_lvalue_hierarchy)
-			logic_cones[item].merge(logic_cone);
-	} else {
-		visited_ffs.emplace(ff);
-		current_lvalue_hierarchy.emplace_back(ff);
-		walk(flipflops[ff.offset]);
-		current_lvalue_hierarchy.pop_back();
+// Extends the best paths through `child`, if that makes them better. Ties go to earlier children.
+void PathFinder::Depths::offer(NodeId child, const Depths &depths, uint32_t expansion) {
+	if (depths.longest.length != 0 && depths.longest.length + 1 > longest.length)
+		longest = {depths.longest.length + 1, child, expansion};
+	if (depths.shortest.length != 0 &&
+	    (shortest.length == 0 || depths.shortest.length + 1 < shortest.length))
+		shortest = {depths.shortest.length + 1, child, expansion};
+}
+
+// The depths of every node as if all flip-flops had been visited
+PathFinder::PathFinder(const Circuit &ckt, const Implementation &graph)
+    : graph(graph), flipflops(ckt.state()), depths(graph.size()), expanded(graph.size()),
+      visited_ffs(flipflops.size()) {
+	for (NodeId id = 0; id < graph.size(); id++) {
+		const Node &node = graph[id];
+		if (std::holds_alternative<ast::Input>(node.token))
+			depths[id].longest = depths[id].shortest = {1, NO_NODE, NONE};
+		for (NodeId child : node.children)
+			if (child != NO_NODE)
+				depths[id].offer(child, depths[child], NONE);
+	}
+}
+
+/* Visits `root` like the depth-first walk would, and returns the expansion where the depths of
+ * this visit are stored. Nodes that were already expanded in full use their depths instead, but
+ * nodes that are still being expanded must be expanded again, as there may be flip-flops below
+ * them that have not been visited yet.
+ */
+uint32_t PathFinder::expand(NodeId root) {
+	struct Frame {
+		NodeId node;
+		uint32_t expansion;
+		std::array<NodeId, 2> next;
+		size_t index;
+	};
+	std::vector<Frame> stack;
+	auto enter = [&](NodeId id) {
+		const Node &node = graph[id];
+		Frame frame{id, uint32_t(expansions.size()), node.children, 0};
+		expansions.emplace_back();
+		if (std::holds_alternative<ast::Input>(node.token))
+			expansions.back().longest = expansions.back().shortest = {1, NO_NODE, NONE};
+		else if (std::holds_alternative<ast::Flipflop>(node.token)) {
+			// Flip-flops are dead ends once they have been visited
+			size_t ff = std::get<ast::Flipflop>(node.token).offset;
+			frame.next = {visited_ffs[ff] ? NO_NODE : flipflops[ff], NO_NODE};
+			visited_ffs[ff] = true;
+		}
+		stack.push_back(frame);
+	};
+
+	enter(root);
+	while (true) {
+		Frame &top = stack.back();
+		if (top.index < top.next.size() && top.next[top.index] != NO_NODE) {
+			NodeId child = top.next[top.index++];
+			if (expanded[child])
+				expansions[top.expansion].offer(child, depths[child], NONE);
+			else
+				enter(child);
+			continue;
+		}
+
+		Frame done = top;
+		stack.pop_back();
+		expanded[done.node] = true;
+		if (stack.empty())
+			return done.expansion;
+		Depths child = expansions[done.expansion];
+		expansions[stack.back().expansion].offer(done.node, child, done.expansion);
+	}
+}
+
+void PathFinder::add_output(NodeId root) {
+	uint32_t expansion = expand(root);
+	const Depths &result = expansions[expansion];
+	uint64_t longest_length =
+	    longest.first != NO_NODE ? expansions[longest.second].longest.length : 0;
+	uint64_t shortest_length =
+	    shortest.first != NO_NODE ? expansions[shortest.second].shortest.length : 0;
+	if (result.longest.length > longest_length)
+		longest = {root, expansion};
+	if (result.shortest.length != 0 &&
+	    (result.shortest.length < shortest_length || shortest_length == 0))
+		shortest = {root, expansion};
+}
+
+// Follows the steps of the longest or shortest path from the start
+Path PathFinder::rebuild(std::pair<NodeId, uint32_t> start, Step Depths::*which) const {
+	Path path;
+	if (start.first == NO_NODE)
+		return path;
+	NodeId node = start.first;
+	Step step = expansions[start.second].*which;
+	while (true) {
+		path.path.push_back(graph[node].token);
+		if (step.node == NO_NODE)
+			return path;
+		node = step.node;
+		step = step.expansion != NONE ? expansions[step.expansion].*which : depths[node].*which;
+	}
+}
+
+void Cone::merge(const Cone &other, size_t input_count) {
+	if (dense.empty() && other.dense.empty()) {
+		std::vector<uint32_t> merged;
+		merged.reserve(sparse.size() + other.sparse.size());
+		std::set_union(sparse.begin(), sparse.end(), other.sparse.begin(), other.sparse.end(),
+		               std::back_inserter(merged));
+		sparse = std::move(merged);
+		// A list takes 32 bits per input, a bitset 1 bit per input of the whole circuit
+		if (sparse.size() <= input_count / 32)
+			return;
+	}
+	if (dense.empty()) {
+		dense.assign((input_count + 63) / 64, 0);
+		for (uint32_t input : sparse)
+			dense[input / 64] |= uint64_t(1) << (input % 64);
+		sparse.clear();
+		sparse.shrink_to_fit();
+	}
+	for (size_t word = 0; word < other.dense.size(); word++)
+		dense[word] |= other.dense[word];
+	for (uint32_t input : other.sparse)
+		dense[input / 64] |= uint64_t(1) << (input % 64);
+}
+
+namespace {
+	// Computes the union of several cones, and only copies one when two different ones meet
+	class ConeUnion {
+		std::shared_ptr<const Cone> result;
+		std::shared_ptr<Cone> owned;
+		size_t input_count;
+
+	  public:
+		explicit ConeUnion(size_t input_count) : input_count(input_count) {}
+
+		void add(const std::shared_ptr<const Cone> &cone) {
+			if (cone == nullptr || cone == result)
+				return;
+			if (result == nullptr) {
+				result = cone;
+				return;
+			}
+			if (owned == nullptr)
+				result = owned = std::make_shared<Cone>(*result);
+			owned->merge(*cone, input_count);
+		}
+		// Null if the union is empty
+		std::shared_ptr<const Cone> get() const { return result; }
+	};
+} // namespace
+
+ConeFinder::ConeFinder(const Circuit &ckt, const Implementation &graph, size_t input_count)
+    : graph(graph), flipflops(ckt.state()), input_count(input_count), parents(graph.size(), 0),
+      order(graph.size(), NONE), lowlink(graph.size(), NONE), component(graph.size(), NONE) {
+	// Count the edges into every node that can be reached from the outputs, where every output
+	// is an edge too
+	std::vector<bool> seen(graph.size(), false);
+	std::vector<NodeId> pending;
+	for (NodeId output : ckt.outputs()) {
+		parents[output]++;
+		if (!seen[output])
+			pending.push_back(output);
+		seen[output] = true;
+	}
+	while (!pending.empty()) {
+		NodeId id = pending.back();
+		pending.pop_back();
+		for (NodeId successor : successors(id)) {
+			if (successor == NO_NODE)
+				continue;
+			parents[successor]++;
+			if (!seen[successor])
+				pending.push_back(successor);
+			seen[successor] = true;
+		}
+	}
+}
+
+// The nodes that a node depends on. A flip-flop depends on its input expression.
+std::array<NodeId, 2> ConeFinder::successors(NodeId id) const {
+	const Node &node = graph[id];
+	if (std::holds_alternative<ast::Flipflop>(node.token))
+		return {flipflops[std::get<ast::Flipflop>(node.token).offset], NO_NODE};
+	return node.children;
+}
+
+// Computes the cone of `output`, and those below it that are not known yet
+void ConeFinder::prepare(NodeId output) {
+	struct Frame {
+		NodeId id;
+		size_t next; // Successor
+	};
+	std::vector<Frame> stack;
+	auto enter = [&](NodeId id) {
+		order[id] = lowlink[id] = visited++;
+		unfinished.push_back(id);
+		stack.push_back({id, 0});
+	};
+
+	if (order[output] != NONE)
+		return;
+	enter(output);
+	while (!stack.empty()) {
+		Frame &top = stack.back();
+		std::array<NodeId, 2> next = successors(top.id);
+		if (top.next < next.size() && next[top.next] != NO_NODE) {
+			NodeId successor = next[top.next++];
+			if (order[successor] == NONE)
+				enter(successor);
+			else if (component[successor] == NONE)
+				lowlink[top.id] = std::min(lowlink[top.id], order[successor]);
+			continue;
+		}
+
+		NodeId id = top.id;
+		stack.pop_back();
+		if (lowlink[id] == order[id])
+			finish_component(id);
+		if (!stack.empty())
+			lowlink[stack.back().id] = std::min(lowlink[stack.back().id], lowlink[id]);
 	}
 }
 
-void GraphWalker::process(ast::Operator) { ; }
+// Pops the component of `root` off the Tarjan stack, and computes its cone
+void ConeFinder::finish_component(NodeId root) {
+	uint32_t index = cones.size();
+	std::vector<NodeId> members;
+	do {
+		members.push_back(unfinished.back());
+		unfinished.pop_back();
+		component[members.back()] = index;
+	} while (members.back() != root);
 
-void analysis::run(const ast::Module &module) {
-	std::vector<Node> inputs;
+	ConeUnion cone(input_count);
+	uint32_t inner_edges = 0, edges_in = 0;
+	std::vector<uint32_t> done; // Components whose cones are no longer needed
+	for (NodeId member : members) {
+		edges_in += parents[member];
+		const Token &token = graph[member].token;
+		if (std::holds_alternative<ast::Input>(token))
+			cone.add(std::make_shared<const Cone>(std::get<ast::Input>(token).offset));
+		for (NodeId successor : successors(member)) {
+			if (successor == NO_NODE)
+				continue;
+			uint32_t below = component[successor];
+			if (below == index) {
+				inner_edges++;
+				continue;
+			}
+			cone.add(cones[below]);
+			if (--readers[below] == 0)
+				done.push_back(below);
+		}
+	}
+	for (uint32_t below : done)
+		cones[below] = nullptr;
+	cones.push_back(cone.get());
+	readers.push_back(edges_in - inner_edges);
+}
+
+std::shared_ptr<const Cone> ConeFinder::cone_of(NodeId output) const {
+	return cones[component[output]];
+}
+
+void ConeFinder::release(NodeId output) {
+	uint32_t index = component[output];
+	if (--readers[index] == 0)
+		cones[index] = nullptr;
+}
+
+void analysis::run(const ast::Module &module, size_t threads) {
+	Implementation impl;
+	std::vector<NodeId> inputs;
 	// The i-th input is just a childless wrapper around the ast::Input token
 	for (size_t i = 0; i < module.input_size(); i++)
-		inputs.push_back(Node{ast::Input{i}, {}});
+		inputs.push_back(impl.intern({ast::Input{i}}));
 
-	Implementation impl;
 	Circuit ckt(module, impl);
 	ckt.evaluate(inputs);
 
-	GraphWalker walker(ckt);
-	for (size_t i = 0; i < ckt.outputs().size(); i++)
-		walker.walk_output(ast::Output{i});
-
-	std::cout << "Shortest path: " << walker.shortest_path.toString(module) << std::endl;
-	std::cout << "Longest path: " << walker.longest_path.toString(module) << std::endl;
-	for (size_t i = 0; i < module.output_size(); i++) {
-		ast::Output output{i};
-		std::cout << "Logic cone for " << module.name_of(output) << ":" << std::endl;
-		for (const size_t &item_idx : walker.logic_cones[output])
-			std::cout << "  - " << module.name_of(ast::Input{item_idx}) << std::endl;
+	PathFinder paths(ckt, impl);
+	for (NodeId output : ckt.outputs())
+		paths.add_output(output);
+	std::cout << "Shortest path: " << paths.shortest_path().toString(module) << std::endl;
+	std::cout << "Longest path: " << paths.longest_path().toString(module) << std::endl;
+
+	// The cones are listed in batches, so that only those of a batch are kept in memory. Only the
+	// formatting is parallel: the cones are computed by a single depth-first walk, which frees each
+	// one as soon as the walk is past it, and takes a small part of the time anyway.
+	ConeFinder cones(ckt, impl, module.input_size());
+	ThreadPool pool(threads);
+	const size_t batch_size = 64 * pool.size();
+	std::vector<std::string> texts;
+	for (size_t first = 0; first < module.output_size(); first += batch_size) {
+		size_t last = std::min(first + batch_size, module.output_size());
+		for (size_t i = first; i < last; i++)
+			cones.prepare(ckt.outputs()[i]);
+		texts.assign(last - first, "");
+		pool.parallel_for(last - first, [&](size_t i) {
+			ast::Output output{first + i};
+			std::string &text = texts[i];
+			text = "Logic cone for " + module.name_of(output) + ":\n";
+			if (auto cone = cones.cone_of(ckt.outputs()[output.offset]))
+				cone->for_each([&](uint32_t input) {
+					text += "  - " + module.name_of(ast::Input{input}) + "\n";
+				});
+		});
+		for (size_t i = first; i < last; i++) {
+			std::cout << texts[i - first];
+			cones.release(ckt.outputs()[i]);
+		}
+		std::cout.flush();
 	}
-}
\ No newline at end of file
+}
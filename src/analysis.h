@@ -1,35 +1,51 @@
 #pragma once
 
 #include "generic.hpp"
-#include <forward_list>
-#include <map>
-#include <set>
-#include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <memory>
 
 namespace analysis {
 	using Token = std::variant<ast::Operator, ast::Input, ast::Flipflop>;
 
+	// Nodes are referred to by their index in the Implementation
+	using NodeId = uint32_t;
+	constexpr NodeId NO_NODE = UINT32_MAX;
+
 	struct Node {
 		Token token;
-		std::array<Node *, 2> children;
+		std::array<NodeId, 2> children = {NO_NODE, NO_NODE};
+
+		bool operator==(const Node &other) const {
+			return token == other.token && children == other.children;
+		}
 	};
 
 	class Implementation;
-	using Engine = GenericSimulator<Node, Implementation>;
-
+	using Engine = GenericSimulator<NodeId, Implementation>;
+
+	/* The nodes of the graph, stored contiguously and freed all at once. The circuit only passes
+	 * their ids around. Nodes are hash-consed: structurally equal subexpressions share a single
+	 * node, so the graph is a DAG with one node per distinct gate. A node is created after its
+	 * children, so ids are in topological order.
+	 *
+	 * Node 0 is a childless operator, like a default-constructed Node, which is what the circuit
+	 * holds for outputs that are never assigned.
+	 */
 	class Implementation {
-		/* Linked lists are the only data structures that allow us to use pointers to nodes. Other
-		 * containers (eg. vectors) could invalidate them.
-		 */
-		std::forward_list<Node> nodes;
+		std::vector<Node> nodes;
+		std::vector<NodeId> table; // Open addressing, NO_NODE where empty
 
-		Node *fetch_operand(Engine::OperandStack &node);
+		void grow();
 
 	  public:
-		Implementation() = default;
-		static void initialize(std::vector<Node> &state);
+		Implementation() { intern(Node{}); }
+		void initialize(std::vector<NodeId> &state);
 		void on_operator(ast::Operator, Engine::OperandStack &stack);
+
+		// The node with this token and children, created if there is none yet
+		NodeId intern(const Node &);
+		const Node &operator[](NodeId id) const { return nodes[id]; }
+		size_t size() const { return nodes.size(); }
 	};
 
 	using StackMachine = Engine::StackMachine;
@@ -42,30 +58,114 @@ namespace analysis {
 		std::string toString(const ast::Module &module) const;
 	};
 
-	class GraphWalker {
-		std::vector<Node> outputs;
-		std::vector<Node> flipflops;
-		std::deque<Token> current_path;
-		std::deque<ast::LValue> current_lvalue_hierarchy;
-		std::unordered_set<ast::Flipflop> visited_ffs;
+	// A set of inputs, kept as a sorted list while it is small and as a bitset otherwise
+	class Cone {
+		std::vector<uint32_t> sparse;
+		std::vector<uint64_t> dense;
+
+	  public:
+		Cone() = default;
+		explicit Cone(uint32_t input) : sparse{input} {}
+
+		bool empty() const { return sparse.empty() && dense.empty(); }
+		// Adds the inputs of `other`, out of `input_count`
+		void merge(const Cone &other, size_t input_count);
+
+		// Calls `f` on every input, in increasing order
+		template <class F>
+		void for_each(F f) const {
+			for (uint32_t input : sparse)
+				f(input);
+			for (size_t word = 0; word < dense.size(); word++)
+				for (uint64_t bits = dense[word]; bits != 0; bits &= bits - 1)
+					f(uint32_t(word * 64 + __builtin_ctzll(bits)));
+		}
+	};
+
+	/* Finds the inputs that each output depends on, directly or through flip-flops.
+	 *
+	 * Cones are computed bottom-up, once per node of the DAG. Flip-flops can form cycles, so the
+	 * nodes are grouped into strongly connected components with Tarjan's algorithm, whose members
+	 * share the union of their own inputs and of the cones of the components below them. A node
+	 * whose cone equals the one of a child shares it, and cones are freed as soon as every node
+	 * above them is done, so that only the frontier of the walk is kept in memory.
+	 *
+	 * Outputs are handled in batches: prepare() computes the cone of each output in turn, then
+	 * cone_of() can be called for the whole batch concurrently, and release() frees them.
+	 */
+	class ConeFinder {
+		using ConePtr = std::shared_ptr<const Cone>;
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		const Implementation &graph;
+		const std::vector<NodeId> &flipflops;
+		size_t input_count;
+
+		std::vector<uint32_t> parents; // Edges from nodes that can be reached from the outputs
+		// Tarjan's algorithm
+		std::vector<uint32_t> order, lowlink, component;
+		std::vector<uint32_t> unfinished;
+		uint32_t visited = 0;
+		// Per component: its cone, and the edges from other components that still need it
+		std::vector<ConePtr> cones;
+		std::vector<uint32_t> readers;
+
+		std::array<NodeId, 2> successors(NodeId) const;
+		void finish_component(NodeId root);
 
 	  public:
-		// The set is ordered for aesthetic reasons.
-		using LogicCone = std::set<size_t>;
-		std::unordered_map<ast::LValue, LogicCone> logic_cones;
-		Path longest_path, shortest_path;
-
-		GraphWalker(const Circuit &ckt)
-		    : outputs(ckt.outputs()), flipflops(ckt.state()), longest_path({}), shortest_path({}) {}
-		void walk_output(ast::Output);
-
-	  private:
-		void walk(const Node &node);
-		void process(ast::Input);
-		void process(ast::Flipflop);
-		void process(ast::Operator);
+		ConeFinder(const Circuit &ckt, const Implementation &graph, size_t input_count);
+
+		void prepare(NodeId output);
+		ConePtr cone_of(NodeId output) const;
+		void release(NodeId output);
+	};
+
+	/* Finds the longest and shortest paths from the outputs to the inputs in linear time.
+	 *
+	 * The paths are the same that a depth-first walk from every output in turn would find: a
+	 * flip-flop is followed into its input expression the first time the walk meets it, and is a
+	 * dead end afterwards. Ties go to the path met first. Once the walk has gone through a node,
+	 * every flip-flop below it has been met, so further visits of the node see a flip-flop-free
+	 * DAG: its depths are computed once by dynamic programming in topological order. Only the
+	 * first visit of each node ("expansion") depends on the walk, and it is done iteratively.
+	 */
+	class PathFinder {
+		static constexpr uint32_t NONE = UINT32_MAX;
+
+		// The next node on the best path from a node, and the length of the path from the node
+		struct Step {
+			uint64_t length = 0; // 0 if no input can be reached
+			NodeId node = NO_NODE;
+			uint32_t expansion = NONE; // Where to continue from `node`, or NONE to use `depths`
+		};
+		struct Depths {
+			Step longest, shortest;
+			void offer(NodeId child, const Depths &, uint32_t expansion);
+		};
+
+		const Implementation &graph;
+		const std::vector<NodeId> &flipflops;
+		std::vector<Depths> depths;
+		std::vector<Depths> expansions;
+		std::vector<bool> expanded;
+		std::vector<bool> visited_ffs;
+		// The output whose path is the best so far, and the expansion it starts from
+		std::pair<NodeId, uint32_t> longest = {NO_NODE, NONE}, shortest = {NO_NODE, NONE};
+
+		uint32_t expand(NodeId root);
+		Path rebuild(std::pair<NodeId, uint32_t> start, Step Depths::*which) const;
+
+	  public:
+		PathFinder(const Circuit &ckt, const Implementation &graph);
+		// Outputs must be added in the order they are walked
+		void add_output(NodeId root);
+
+		Path longest_path() const { return rebuild(longest, &Depths::longest); }
+		Path shortest_path() const { return rebuild(shortest, &Depths::shortest); }
 	};
 
-	void run(const ast::Module &);
+	// Uses `threads` threads to list the logic cones, or one per core if 0
+	void run(const ast::Module &, size_t threads);
 
 } // namespace analysis
@@ -30,23 +30,26 @@ std::string Module::name_of(Token t) const {
 	return std::visit([&](auto &&token) { return name_of(token); }, t);
 }
 
-std::optional<Operator> ast::try_resolve_operator(std::string name) {
-	if (name == "NOT")
-		return Operator::NOT;
-	else if (name == "AND")
-		return Operator::AND;
-	else if (name == "OR")
-		return Operator::OR;
-	else if (name == "XOR")
-		return Operator::XOR;
-	else if (name == "NAND")
-		return Operator::NAND;
-	else if (name == "NOR")
-		return Operator::NOR;
-	else if (name == "XNOR")
-		return Operator::XNOR;
-	else
+/* Operators are found with a perfect hash of their first and last letter and their length, so
+ * that identifiers are rejected after a single comparison.
+ */
+std::optional<Operator> ast::try_resolve_operator(std::string_view name) {
+	struct Keyword {
+		std::string_view name;
+		Operator op;
+	};
+	static const Keyword keywords[8] = {
+	    {"", Operator::NOT},      {"NOT", Operator::NOT}, {"XNOR", Operator::XNOR},
+	    {"NOR", Operator::NOR},   {"AND", Operator::AND}, {"XOR", Operator::XOR},
+	    {"NAND", Operator::NAND}, {"OR", Operator::OR},
+	};
+	if (name.size() < 2 || name.size() > 4)
 		return {};
+	size_t hash = uint8_t(name.front()) + 3 * uint8_t(name.back()) + 5 * name.size();
+	const Keyword &keyword = keywords[hash % 8];
+	if (name != keyword.name)
+		return {};
+	return keyword.op;
 }
 
 uint8_t ast::arity(Operator op) {
@@ -2,12 +2,13 @@
 
 #include "utils.h"
 #include <optional>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace ast {
 	enum class Operator { NOT, AND, OR, XOR, NAND, NOR, XNOR };
-	std::optional<Operator> try_resolve_operator(std::string);
+	std::optional<Operator> try_resolve_operator(std::string_view);
 	uint8_t arity(Operator);
 
 	struct Input {
@@ -45,6 +46,8 @@ namespace ast {
 		Expression expression;
 		Assignment(const ast::LValue &lvalue, const Expression &expr)
 		    : lvalue(lvalue), expression(expr){};
+		Assignment(const ast::LValue &lvalue, Expression &&expr)
+		    : lvalue(lvalue), expression(std::move(expr)){};
 	};
 
 	class Module {
@@ -62,8 +65,9 @@ namespace ast {
 		Module(bool isClocked, std::vector<std::string> input_names,
 		       std::vector<uint16_t> flipflop_ids, std::vector<std::string> output_names,
 		       std::vector<Assignment> assignments)
-		    : isClocked(isClocked), input_names(input_names), flipflop_ids(flipflop_ids),
-		      output_names(output_names), assignments(assignments) {}
+		    : isClocked(isClocked), input_names(std::move(input_names)),
+		      flipflop_ids(std::move(flipflop_ids)), output_names(std::move(output_names)),
+		      assignments(std::move(assignments)) {}
 
 		std::string name_of(Input) const;
 		std::string name_of(Flipflop) const;
@@ -0,0 +1,38 @@
+#include "backgroundwriter.h"
+
+BackgroundWriter::BackgroundWriter(std::ostream &out) : out(out) {
+	thread = std::thread(&BackgroundWriter::write_loop, this);
+}
+
+BackgroundWriter::~BackgroundWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	thread.join();
+}
+
+void BackgroundWriter::write(std::string &buffer) {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [&]() { return !busy; });
+	std::swap(buffer, pending);
+	buffer.clear();
+	busy = true;
+	changed.notify_all();
+}
+
+void BackgroundWriter::write_loop() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [&]() { return busy || stopping; });
+		if (!busy)
+			return;
+		lock.unlock();
+		out.write(pending.data(), pending.size());
+		out.flush();
+		lock.lock();
+		busy = false;
+		changed.notify_all();
+	}
+}
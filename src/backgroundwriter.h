@@ -0,0 +1,33 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/* Writes buffers to a stream on a thread of its own, one at a time, so that the caller can fill the
+ * next buffer in the meantime. The stream is flushed after every buffer.
+ */
+class BackgroundWriter {
+	std::ostream &out;
+	std::thread thread;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::string pending; // Being written while `busy`
+	bool busy = false, stopping = false;
+
+	void write_loop();
+
+  public:
+	explicit BackgroundWriter(std::ostream &out);
+	// Waits for the last buffer to be written
+	~BackgroundWriter();
+	BackgroundWriter(const BackgroundWriter &) = delete;
+	BackgroundWriter &operator=(const BackgroundWriter &) = delete;
+
+	// Takes over the contents of `buffer`, once the previous one is written, and leaves it empty
+	// but with the capacity of an earlier buffer
+	void write(std::string &buffer);
+};
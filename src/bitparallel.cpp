@@ -0,0 +1,114 @@
+#include "bitparallel.h"
+#include "threadpool.h"
+#include <algorithm>
+
+void bitparallel::Buffer::set(uint32_t slot, size_t lane, TruthValue value) {
+	uint64_t *one = data() + 2 * slot * words + lane / 64;
+	uint64_t *zero = one + words;
+	uint64_t bit = uint64_t(1) << (lane % 64);
+	*one = (value == TruthValue::TRUE) ? (*one | bit) : (*one & ~bit);
+	*zero = (value == TruthValue::FALSE) ? (*zero | bit) : (*zero & ~bit);
+}
+
+TruthValue bitparallel::Buffer::get(uint32_t slot, size_t lane) const {
+	const uint64_t *one = data() + 2 * slot * words + lane / 64;
+	const uint64_t *zero = one + words;
+	uint64_t bit = uint64_t(1) << (lane % 64);
+	if (*one & bit)
+		return TruthValue::TRUE;
+	if (*zero & bit)
+		return TruthValue::FALSE;
+	return TruthValue::X;
+}
+
+namespace {
+	// A slice of the vectors file, which is simulated independently of the others
+	struct Chunk {
+		std::vector<vectorio::Vector> vectors;
+		std::string outputs; // Encoded by the ResultWriter
+	};
+
+	// The outputs of one lane of a buffer
+	struct LaneOutputs {
+		const bytecode::Program &program;
+		const bitparallel::Buffer &buffer;
+		size_t lane;
+
+		TruthValue operator[](size_t i) const {
+			return buffer.get(program.slot_of(ast::Output{i}), lane);
+		}
+	};
+} // namespace
+
+static void simulate(const bytecode::Program &program, const kernels::Kernel &kernel,
+                     bitparallel::Buffer &buffer, size_t lanes, const vectorio::ResultWriter &out,
+                     Chunk &chunk) {
+	chunk.outputs.clear();
+	for (size_t first = 0; first < chunk.vectors.size(); first += lanes) {
+		size_t batch_size = std::min(lanes, chunk.vectors.size() - first);
+		for (size_t lane = 0; lane < batch_size; lane++) {
+			const vectorio::Vector &vector = chunk.vectors[first + lane];
+			for (size_t i = 0; i < program.input_size; i++)
+				buffer.set(program.slot_of(ast::Input{i}), lane, vector[i]);
+		}
+
+		{
+			STATS_TICKS(batch_size);
+			kernel.execute(program, buffer.data());
+		}
+		STATS_ADD(evaluations, program.code.size() * batch_size);
+
+		for (size_t lane = 0; lane < batch_size; lane++)
+			out.encode(chunk.outputs, LaneOutputs{program, buffer, lane});
+	}
+}
+
+void bitparallel::run(const bytecode::Program &program, const kernels::Kernel &kernel,
+                      vectorio::VectorReader &vectors, vectorio::ResultWriter &out,
+                      size_t threads) {
+	bool independent = program.state_size == 0;
+	size_t lanes = independent ? kernel.lanes() : 1;
+
+	// Every worker simulates one chunk at a time with its own buffer, and the chunks are printed in
+	// order once all workers are done. With flip-flops, a single buffer carries the state across
+	// chunks.
+	ThreadPool pool(independent ? threads : 1);
+	const size_t chunk_size = 64 * lanes;
+	std::vector<Chunk> chunks(pool.size());
+	std::vector<Buffer> buffers(pool.size(), Buffer(program.slot_count, kernel.words));
+
+	vectorio::Vector vector;
+	std::string error;
+	uint32_t linenum = 0;
+	bool done = false;
+	while (!done) {
+		// If a line is malformed, the lines before it are still simulated and printed, like the
+		// scalar simulator does.
+		size_t used_chunks = 0;
+		for (Chunk &chunk : chunks) {
+			chunk.vectors.clear();
+			while (chunk.vectors.size() < chunk_size && vectors.next(vector)) {
+				if (vector.size() != program.input_size) {
+					error = "Input size mismatch (line " + std::to_string(linenum) + ")";
+					break;
+				}
+				chunk.vectors.push_back(vector);
+				linenum++;
+			}
+			if (!chunk.vectors.empty())
+				used_chunks++;
+			if (chunk.vectors.size() < chunk_size) {
+				done = true;
+				break;
+			}
+		}
+
+		pool.parallel_for(used_chunks, [&](size_t i) {
+			simulate(program, kernel, buffers[i], lanes, out, chunks[i]);
+		});
+		for (size_t i = 0; i < used_chunks; i++)
+			out.write(chunks[i].outputs, chunks[i].vectors.size());
+	}
+	if (!error.empty())
+		throw error;
+}
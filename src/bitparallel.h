@@ -0,0 +1,108 @@
+#pragma once
+
+#include "generic.hpp"
+#include "kernels.h"
+#include "truthvalue.h"
+#include "vectorio.h"
+
+namespace bitparallel {
+	/* Packs one TruthValue per bit of a machine word, using two "rails": a lane is 1 if its bit is
+	 * set in `one`, 0 if it is set in `zero`, and X if it is set in neither. With this encoding
+	 * every gate is a handful of bitwise operations, which reproduce the X semantics of
+	 * TruthValue exactly:
+	 *
+	 *  - a AND b is 1 iff both are 1, and 0 iff either is 0;
+	 *  - a OR b is 1 iff either is 1, and 0 iff both are 0;
+	 *  - a XOR b is only defined if both are defined;
+	 *  - NOT a swaps the rails, so X stays X.
+	 */
+	template <typename Word>
+	class PackedTruthValue {
+	  public:
+		static constexpr size_t lanes = sizeof(Word) * 8;
+
+		Word one, zero;
+
+		ALWAYS_INLINE PackedTruthValue() : one(), zero() {}
+		ALWAYS_INLINE PackedTruthValue(Word one, Word zero) : one(one), zero(zero) {}
+
+		ALWAYS_INLINE PackedTruthValue operator&&(PackedTruthValue a) const {
+			return {one & a.one, zero | a.zero};
+		}
+		ALWAYS_INLINE PackedTruthValue operator||(PackedTruthValue a) const {
+			return {one | a.one, zero & a.zero};
+		}
+		ALWAYS_INLINE PackedTruthValue operator^(PackedTruthValue a) const {
+			return {(one & a.zero) | (zero & a.one), (one & a.one) | (zero & a.zero)};
+		}
+		ALWAYS_INLINE PackedTruthValue operator!() const { return {zero, one}; }
+	};
+
+	/* The value buffer of a program that is evaluated `words` * 64 lanes at a time (see kernels.h).
+	 * Each slot is a PackedTruthValue as wide as the kernel: `words` words of the one rail followed
+	 * by `words` words of the zero rail. Initially every lane of every slot is X.
+	 */
+	class Buffer {
+		// Aligned to the widest SIMD register, which the kernels assume
+		struct alignas(64) Block {
+			uint64_t words[8];
+		};
+
+		size_t words;
+		std::vector<Block> blocks;
+
+	  public:
+		Buffer(size_t slot_count, size_t words)
+		    : words(words), blocks((2 * slot_count * words + 7) / 8) {}
+
+		size_t lanes() const { return 64 * words; }
+		uint64_t *data() { return blocks.data()->words; }
+		const uint64_t *data() const { return blocks.data()->words; }
+
+		void set(uint32_t slot, size_t lane, TruthValue value);
+		TruthValue get(uint32_t slot, size_t lane) const;
+	};
+
+	template <typename Word>
+	class Implementation {
+	  public:
+		using Value = PackedTruthValue<Word>;
+
+		// The state of the system is initially indeterminate, in every lane.
+		static void initialize(std::vector<Value> &state) {
+			std::fill(state.begin(), state.end(), Value());
+		}
+
+		ALWAYS_INLINE static Value apply(ast::Operator astOperator, Value lhs, Value rhs) {
+			switch (astOperator) {
+				case ast::Operator::NOT:
+					return !lhs;
+				case ast::Operator::AND:
+					return lhs && rhs;
+				case ast::Operator::OR:
+					return lhs || rhs;
+				case ast::Operator::XOR:
+					return lhs ^ rhs;
+				case ast::Operator::NAND:
+					return !(lhs && rhs);
+				case ast::Operator::NOR:
+					return !(lhs || rhs);
+				case ast::Operator::XNOR:
+					return !(lhs ^ rhs);
+			}
+			// The parser only makes the operators above, and the kernels are kept free of throws
+			__builtin_unreachable();
+		}
+	};
+
+	template <typename Word>
+	using Engine = GenericSimulator<PackedTruthValue<Word>, Implementation<Word>>;
+
+	// Simulates a program with a kernel (see kernels.h), printing the same output as
+	// simulation::run. Without flip-flops, every lane evaluates a different vector, on `threads`
+	// threads (0: one per core). With flip-flops, vectors depend on the previous ones, so they are
+	// simulated one at a time in the first lane, and a wider kernel than the scalar one only adds
+	// work.
+	void run(const bytecode::Program &, const kernels::Kernel &, vectorio::VectorReader &vectors,
+	         vectorio::ResultWriter &out, size_t threads);
+} // namespace bitparallel
@@ -0,0 +1,363 @@
+#include "bytecode.h"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+
+using namespace bytecode;
+
+static_assert(Opcode(ast::Operator::XNOR) == Opcode::XNOR, "Opcodes must mirror ast::Operator");
+
+// Maps the operands of each kind of gate, as (lhs << 32 | rhs), to the slot holding the result
+using GateTable = std::array<std::unordered_map<uint64_t, uint32_t>, size_t(Opcode::COPY)>;
+
+// All binary operators are commutative, so sorting their operands makes equal gates look equal
+static uint64_t gate_key(Instruction &instruction) {
+	if (instruction.lhs > instruction.rhs)
+		std::swap(instruction.lhs, instruction.rhs);
+	return uint64_t(instruction.lhs) << 32 | instruction.rhs;
+}
+
+/* Lowers each expression by running the stack machine "symbolically": instead of values, the
+ * operand stack holds the slots where the values will be found at run time. Every operator gets a
+ * fresh slot, except for the root of the expression which writes directly to its lvalue.
+ *
+ * Gates are hash-consed across the whole module: a gate with the same operator and operands as an
+ * earlier one reuses its slot instead of being evaluated again. This is sound because every slot
+ * is written at most once per tick, before it is read.
+ */
+Program bytecode::compile(const ast::Module &module) {
+	Program program(module.input_size(), module.state_size(), module.output_size());
+	std::stack<uint32_t> operands;
+	GateTable gates;
+
+	for (const ast::Assignment &assignment : module.assignments) {
+		const ast::Expression &expression = assignment.expression;
+		uint32_t dst;
+		if (is_output(assignment.lvalue)) {
+			dst = program.slot_of(get_output(assignment.lvalue));
+		} else {
+			ast::Flipflop ff = get_ff(assignment.lvalue);
+			dst = program.next_state_slot(ff);
+			program.latches.push_back({dst, program.slot_of(ff)});
+		}
+
+		for (auto it = expression.rbegin(); it != expression.rend(); it++) {
+			const ast::Token &token = *it;
+			if (is_input(token))
+				operands.push(program.slot_of(get_input(token)));
+			else if (is_ff(token))
+				operands.push(program.slot_of(get_ff(token)));
+			else if (is_output(token))
+				operands.push(program.slot_of(get_output(token)));
+			else if (is_operator(token)) {
+				ast::Operator op = get_operator(token);
+				if (operands.size() < ast::arity(op))
+					throw "The operand stack is empty"s;
+				Instruction instruction{Opcode(op), 0, pop(operands), 0};
+				instruction.rhs = ast::arity(op) == 2 ? pop(operands) : instruction.lhs;
+				auto [gate, inserted] = gates[size_t(op)].try_emplace(gate_key(instruction));
+				if (inserted) {
+					bool is_root = std::next(it) == expression.rend();
+					gate->second = instruction.dst = is_root ? dst : program.slot_count++;
+					program.code.push_back(instruction);
+				}
+				operands.push(gate->second);
+			}
+		}
+
+		if (operands.empty())
+			throw "The operand stack is empty"s;
+		if (operands.size() > 1)
+			throw "The operand stack contains more than one item"s;
+		uint32_t result = pop(operands);
+		if (result != dst)
+			program.code.push_back({Opcode::COPY, dst, result, result});
+		program.blocks.push_back(program.code.size());
+	}
+
+	return program;
+}
+
+/* The passes below rely on the same invariants as compile(): instructions are in topological order
+ * and every slot is written at most once per tick, before it is read. An instruction can thus read
+ * any earlier result in place of its operand, which is how most passes make instructions dead.
+ */
+
+// Removes the instructions in `dead`, and the blocks left empty
+static void remove_instructions(Program &program, const std::vector<bool> &dead) {
+	std::vector<Instruction> code;
+	code.reserve(program.code.size());
+	std::vector<uint32_t> blocks{0};
+	for (size_t block = 0; block + 1 < program.blocks.size(); block++) {
+		for (uint32_t i = program.blocks[block]; i < program.blocks[block + 1]; i++)
+			if (!dead[i])
+				code.push_back(program.code[i]);
+		if (code.size() != blocks.back())
+			blocks.push_back(code.size());
+	}
+	program.code = std::move(code);
+	program.blocks = std::move(blocks);
+}
+
+// The identity, as a starting point for renaming slots
+static std::vector<uint32_t> identity(size_t size) {
+	std::vector<uint32_t> slots(size);
+	std::iota(slots.begin(), slots.end(), 0);
+	return slots;
+}
+
+static Opcode negate(Opcode opcode) {
+	switch (opcode) {
+		case Opcode::NOT:
+			return Opcode::COPY;
+		case Opcode::AND:
+			return Opcode::NAND;
+		case Opcode::OR:
+			return Opcode::NOR;
+		case Opcode::XOR:
+			return Opcode::XNOR;
+		case Opcode::NAND:
+			return Opcode::AND;
+		case Opcode::NOR:
+			return Opcode::OR;
+		case Opcode::XNOR:
+			return Opcode::XOR;
+		case Opcode::COPY:
+			return Opcode::NOT;
+	}
+	throw "Unknown opcode"s;
+}
+
+/* Turns NOT (a AND b) into a NAND b, and so on, by making the inner gate write the negated result
+ * directly, if nothing else reads it. NOT NOT a becomes a, whatever reads the inner NOT.
+ */
+static void fold_negations(Program &program) {
+	std::vector<Instruction> &code = program.code;
+	std::vector<uint32_t> renamed = identity(program.slot_count);
+	std::vector<uint32_t> writer(program.slot_count, UINT32_MAX);
+	std::vector<uint32_t> readers(program.slot_count, 0);
+	std::vector<bool> dead(code.size(), false);
+	for (const Instruction &instruction : code) {
+		readers[instruction.lhs]++;
+		if (instruction.rhs != instruction.lhs)
+			readers[instruction.rhs]++;
+	}
+
+	for (uint32_t i = 0; i < code.size(); i++) {
+		Instruction &instruction = code[i];
+		instruction.lhs = renamed[instruction.lhs];
+		instruction.rhs = renamed[instruction.rhs];
+		uint32_t operand = instruction.lhs;
+		if (instruction.opcode == Opcode::NOT && writer[operand] != UINT32_MAX) {
+			Instruction &inner = code[writer[operand]];
+			if (inner.opcode == Opcode::NOT) {
+				instruction = {Opcode::COPY, instruction.dst, inner.lhs, inner.lhs};
+				readers[inner.lhs]++;
+				if (--readers[operand] == 0 && program.is_temporary(operand)) {
+					dead[writer[operand]] = true;
+					readers[inner.lhs]--;
+				}
+			} else if (readers[operand] == 1 && program.is_temporary(operand)) {
+				inner.opcode = negate(inner.opcode);
+				inner.dst = instruction.dst;
+				writer[inner.dst] = writer[operand];
+				dead[i] = true;
+				continue;
+			}
+		}
+		if (instruction.opcode == Opcode::COPY && program.is_temporary(instruction.dst)) {
+			renamed[instruction.dst] = instruction.lhs;
+			readers[instruction.lhs] += readers[instruction.dst] - 1;
+			dead[i] = true;
+			continue;
+		}
+		writer[instruction.dst] = i;
+	}
+	remove_instructions(program, dead);
+}
+
+// Gates with the same operator and operands as an earlier one read its result instead. This
+// catches the duplicates that the other passes create.
+static void merge_duplicates(Program &program) {
+	std::vector<uint32_t> renamed = identity(program.slot_count);
+	std::vector<bool> dead(program.code.size(), false);
+	GateTable gates;
+	for (uint32_t i = 0; i < program.code.size(); i++) {
+		Instruction &instruction = program.code[i];
+		instruction.lhs = renamed[instruction.lhs];
+		instruction.rhs = renamed[instruction.rhs];
+		if (instruction.opcode == Opcode::COPY)
+			continue;
+		auto [gate, inserted] =
+		    gates[size_t(instruction.opcode)].try_emplace(gate_key(instruction), instruction.dst);
+		if (inserted)
+			continue;
+		if (program.is_temporary(instruction.dst)) {
+			renamed[instruction.dst] = gate->second;
+			dead[i] = true;
+		} else
+			instruction = {Opcode::COPY, instruction.dst, gate->second, gate->second};
+	}
+	remove_instructions(program, dead);
+}
+
+/* Plain assignments such as `assign x2 = x1` are inlined: instructions read x1 instead of x2, and
+ * so do latches, unless x1 is a flip-flop that a latch may have already overwritten. A COPY is
+ * removed if its destination is neither an output nor read by a latch anymore.
+ */
+static void forward_copies(Program &program) {
+	std::vector<uint32_t> renamed = identity(program.slot_count);
+	for (Instruction &instruction : program.code) {
+		instruction.lhs = renamed[instruction.lhs];
+		instruction.rhs = renamed[instruction.rhs];
+		if (instruction.opcode == Opcode::COPY)
+			renamed[instruction.dst] = instruction.lhs;
+	}
+
+	std::vector<bool> observable(program.slot_count, false);
+	for (size_t i = 0; i < program.output_size; i++)
+		observable[program.slot_of(ast::Output{i})] = true;
+	for (Latch &latch : program.latches) {
+		uint32_t from = renamed[latch.from];
+		if (from < program.state_base() || from >= program.output_base())
+			latch.from = from;
+		observable[latch.from] = true;
+	}
+
+	std::vector<bool> dead(program.code.size(), false);
+	for (uint32_t i = 0; i < program.code.size(); i++)
+		dead[i] = program.code[i].opcode == Opcode::COPY && !observable[program.code[i].dst];
+	remove_instructions(program, dead);
+}
+
+// Removes the instructions and latches that no output depends on, not even through flip-flops,
+// unless they write flip-flops and `keep_state` is set
+static void remove_dead_code(Program &program, bool keep_state) {
+	std::vector<uint32_t> writer(program.slot_count, UINT32_MAX);
+	for (uint32_t i = 0; i < program.code.size(); i++)
+		writer[program.code[i].dst] = i;
+	std::vector<uint32_t> latch_of(program.slot_count, UINT32_MAX);
+	for (uint32_t i = 0; i < program.latches.size(); i++)
+		latch_of[program.latches[i].to] = i;
+
+	std::vector<bool> live(program.slot_count, false);
+	std::vector<uint32_t> pending;
+	auto mark = [&](uint32_t slot) {
+		if (!live[slot]) {
+			live[slot] = true;
+			pending.push_back(slot);
+		}
+	};
+	for (size_t i = 0; i < program.output_size; i++)
+		mark(program.slot_of(ast::Output{i}));
+	if (keep_state)
+		for (size_t i = 0; i < program.state_size; i++)
+			mark(program.slot_of(ast::Flipflop{i}));
+	while (!pending.empty()) {
+		uint32_t slot = pending.back();
+		pending.pop_back();
+		if (writer[slot] != UINT32_MAX) {
+			mark(program.code[writer[slot]].lhs);
+			mark(program.code[writer[slot]].rhs);
+		}
+		if (latch_of[slot] != UINT32_MAX)
+			mark(program.latches[latch_of[slot]].from);
+	}
+
+	std::vector<bool> dead(program.code.size());
+	for (uint32_t i = 0; i < program.code.size(); i++)
+		dead[i] = !live[program.code[i].dst];
+	remove_instructions(program, dead);
+	std::vector<Latch> &latches = program.latches;
+	latches.erase(std::remove_if(latches.begin(), latches.end(),
+	                             [&](const Latch &latch) { return !live[latch.to]; }),
+	              latches.end());
+}
+
+std::vector<PassReport> bytecode::optimize(Program &program, bool keep_state) {
+	const std::pair<const char *, std::function<void(Program &)>> passes[] = {
+	    {"fold negations", fold_negations},
+	    {"merge duplicates", merge_duplicates},
+	    {"forward copies", forward_copies},
+	    {"remove dead code", [&](Program &program) { remove_dead_code(program, keep_state); }},
+	};
+	std::vector<PassReport> reports;
+	for (const auto &[name, pass] : passes) {
+		size_t before = program.code.size();
+		pass(program);
+		reports.push_back({name, before, program.code.size()});
+	}
+	return reports;
+}
+
+/* A block is on level n if the deepest block it reads from is on level n - 1, where inputs and
+ * flip-flops are on level 0. Blocks are then stably sorted by level, which preserves the
+ * topological order.
+ */
+void bytecode::levelize(Program &program) {
+	size_t block_count = program.blocks.size() - 1;
+	std::vector<uint32_t> slot_levels(program.slot_count, 0);
+	std::vector<uint32_t> block_levels(block_count);
+	for (size_t block = 0; block < block_count; block++) {
+		// Intermediate slots are written exactly once, so the ones of this block still read 0.
+		uint32_t level = 0;
+		for (uint32_t i = program.blocks[block]; i < program.blocks[block + 1]; i++) {
+			const Instruction &instruction = program.code[i];
+			level = std::max({level, slot_levels[instruction.lhs], slot_levels[instruction.rhs]});
+		}
+		block_levels[block] = ++level;
+		for (uint32_t i = program.blocks[block]; i < program.blocks[block + 1]; i++)
+			slot_levels[program.code[i].dst] = level;
+	}
+
+	std::vector<uint32_t> order(block_count);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+	                 [&](uint32_t a, uint32_t b) { return block_levels[a] < block_levels[b]; });
+
+	std::vector<Instruction> code;
+	code.reserve(program.code.size());
+	std::vector<uint32_t> blocks{0};
+	std::vector<uint32_t> levels{0};
+	for (uint32_t block : order) {
+		while (levels.size() < block_levels[block])
+			levels.push_back(blocks.size() - 1);
+		code.insert(code.end(), program.code.begin() + program.blocks[block],
+		            program.code.begin() + program.blocks[block + 1]);
+		blocks.push_back(code.size());
+	}
+	levels.push_back(blocks.size() - 1);
+
+	program.code = std::move(code);
+	program.blocks = std::move(blocks);
+	program.levels = std::move(levels);
+}
+
+std::vector<std::vector<Range>> bytecode::schedule(const Program &program, size_t tasks,
+                                                   size_t min_size) {
+	std::vector<std::vector<Range>> steps;
+	for (size_t level = 0; level + 1 < program.levels.size(); level++) {
+		uint32_t first_block = program.levels[level], last_block = program.levels[level + 1];
+		uint32_t first = program.blocks[first_block], last = program.blocks[last_block];
+		if (last - first < min_size) {
+			// Consecutive serial levels are merged into a single range
+			if (!steps.empty() && steps.back().size() == 1 && steps.back()[0].last == first)
+				steps.back()[0].last = last;
+			else
+				steps.push_back({{first, last}});
+			continue;
+		}
+
+		std::vector<Range> ranges;
+		uint32_t target_size = (last - first + tasks - 1) / tasks;
+		for (uint32_t block = first_block; block < last_block; block++) {
+			if (ranges.empty() || ranges.back().last - ranges.back().first >= target_size)
+				ranges.push_back({program.blocks[block], program.blocks[block]});
+			ranges.back().last = program.blocks[block + 1];
+		}
+		steps.push_back(std::move(ranges));
+	}
+	return steps;
+}
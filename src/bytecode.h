@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ast.h"
+#include <cstdint>
+
+namespace bytecode {
+	// The first seven opcodes mirror ast::Operator. COPY implements plain assignments such as
+	// `assign x2 = x1`, which have no operator at all.
+	enum class Opcode : uint8_t { NOT, AND, OR, XOR, NAND, NOR, XNOR, COPY };
+	ALWAYS_INLINE ast::Operator to_operator(Opcode opcode) { return ast::Operator(opcode); }
+
+	// Operands are indices into the value buffer ("slots"). Unary instructions ignore `rhs`.
+	struct Instruction {
+		Opcode opcode;
+		uint32_t dst, lhs, rhs;
+	};
+
+	// Moves a flip-flop input into the flip-flop value when the clock ticks
+	struct Latch {
+		uint32_t from, to;
+	};
+
+	/* A program is the flat, register-based form of the toposorted assignments of a module. Every
+	 * value lives in a single buffer laid out as follows:
+	 *
+	 *     [ inputs | state | outputs | flip-flop inputs | intermediate gates ]
+	 *
+	 * so that a tick is a linear scan over `code` followed by the latches, with no allocations.
+	 */
+	class Program {
+	  public:
+		size_t input_size, state_size, output_size;
+		size_t slot_count;
+
+		std::vector<Instruction> code;
+		std::vector<Latch> latches;
+
+		// Instructions are grouped in blocks, one per assignment (except those that optimize()
+		// empties): block i is code[blocks[i], blocks[i + 1]).
+		std::vector<uint32_t> blocks{0};
+		// Only filled by levelize(): level i is made of blocks [levels[i], levels[i + 1]), which
+		// don't depend on each other.
+		std::vector<uint32_t> levels;
+
+		Program(size_t input_size, size_t state_size, size_t output_size)
+		    : input_size(input_size), state_size(state_size), output_size(output_size),
+		      slot_count(input_size + 2 * state_size + output_size) {}
+
+		uint32_t slot_of(ast::Input input) const { return input.offset; }
+		uint32_t slot_of(ast::Flipflop ff) const { return input_size + ff.offset; }
+		uint32_t slot_of(ast::Output output) const {
+			return input_size + state_size + output.offset;
+		}
+		// The slot where the flip-flop input is stored until the end of the tick
+		uint32_t next_state_slot(ast::Flipflop ff) const {
+			return input_size + state_size + output_size + ff.offset;
+		}
+
+		size_t state_base() const { return input_size; }
+		size_t output_base() const { return input_size + state_size; }
+		// Intermediate gates are only read by other instructions, so they can be renamed freely
+		bool is_temporary(uint32_t slot) const {
+			return slot >= input_size + 2 * state_size + output_size;
+		}
+	};
+
+	// The instructions code[first, last)
+	struct Range {
+		uint32_t first, last;
+	};
+
+	Program compile(const ast::Module &);
+
+	// The number of instructions before and after a pass of optimize()
+	struct PassReport {
+		const char *name;
+		size_t before, after;
+	};
+	// Simplifies a compiled program without changing its outputs, and reports the effect of
+	// each pass. Must run before levelize(). With `keep_state`, flip-flops that no output depends
+	// on are kept up to date as well, eg. so that they can be dumped.
+	std::vector<PassReport> optimize(Program &, bool keep_state = false);
+
+	// Sorts the blocks of a program by dependency level
+	void levelize(Program &);
+	// Splits a levelized program into steps that must run one after the other, while the ranges
+	// in each step can run concurrently. Levels are split at block boundaries into up to `tasks`
+	// ranges of similar size, unless they have fewer than `min_size` instructions.
+	std::vector<std::vector<Range>> schedule(const Program &, size_t tasks, size_t min_size);
+
+	// Defined in compiled.hpp
+	template <typename T, class Implementation>
+	ALWAYS_INLINE void execute(const Program &, Range, T *slots, Implementation &);
+	template <typename T>
+	ALWAYS_INLINE void latch(const Program &, T *slots);
+	template <typename T, class Implementation>
+	ALWAYS_INLINE void execute(const Program &, T *slots, Implementation &);
+} // namespace bytecode
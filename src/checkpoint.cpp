@@ -0,0 +1,73 @@
+#include "checkpoint.h"
+#include "utils.h"
+#include "vectorio.h"
+
+static constexpr std::string_view MAGIC = "PCK1";
+static constexpr size_t HEADER_SIZE = 16;
+
+static std::string header(const ast::Module &module) {
+	std::string out(MAGIC);
+	write_le(out, module.input_size(), 4);
+	write_le(out, module.state_size(), 4);
+	write_le(out, module.output_size(), 4);
+	return out;
+}
+
+static size_t record_size(const ast::Module &module) {
+	return 16 + (module.state_size() + 3) / 4 + (module.output_size() + 3) / 4;
+}
+
+static std::vector<TruthValue> unpack(std::string_view bytes, size_t size) {
+	std::vector<TruthValue> values(size);
+	for (size_t i = 0; i < size; i++)
+		values[i] = TruthValue::from_code((uint8_t(bytes[i / 4]) >> (2 * (i % 4))) & 3);
+	return values;
+}
+
+checkpoint::Writer::Writer(const std::string &path, const ast::Module &module) {
+	file.open(path, std::ios::out | std::ios::binary);
+	if (file.fail())
+		throw "Failed to open the checkpoint file."s;
+	std::string header = ::header(module);
+	file.write(header.data(), header.size());
+	background = std::make_unique<BackgroundWriter>(file);
+}
+
+void checkpoint::Writer::begin(uint64_t tick, uint64_t offset) {
+	write_le(record, tick, 8);
+	write_le(record, offset, 8);
+}
+
+checkpoint::Snapshot checkpoint::load(const std::string &path, const ast::Module &module,
+                                      uint64_t tick) {
+	vectorio::MappedFile file(path);
+	std::string_view contents = file.contents();
+	if (contents.substr(0, HEADER_SIZE) != header(module))
+		throw "The checkpoint file doesn't match the circuit"s;
+
+	// A record cut short by a crash is ignored
+	size_t size = record_size(module);
+	auto record = [&](size_t i) { return contents.substr(HEADER_SIZE + i * size, size); };
+	size_t count = (contents.size() - HEADER_SIZE) / size;
+	// The first record after `tick`
+	size_t low = 0, high = count;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		if (read_le(record(middle).substr(0, 8)) <= tick)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low == 0)
+		throw "No checkpoint at or before tick " + std::to_string(tick);
+
+	std::string_view bytes = record(low - 1);
+	Snapshot snapshot;
+	snapshot.tick = read_le(bytes.substr(0, 8));
+	snapshot.offset = read_le(bytes.substr(8, 8));
+	bytes.remove_prefix(16);
+	snapshot.state = unpack(bytes, module.state_size());
+	bytes.remove_prefix((module.state_size() + 3) / 4);
+	snapshot.outputs = unpack(bytes, module.output_size());
+	return snapshot;
+}
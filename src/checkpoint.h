@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ast.h"
+#include "backgroundwriter.h"
+#include "truthvalue.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Snapshots of a simulation, from which it can be resumed without simulating the ticks before
+ * them. A checkpoint file has:
+ *  - a 16-byte header: the magic "PCK1" and the number of inputs, flip-flops and outputs of the
+ *    circuit, 32 bits each;
+ *  - fixed-size records, by increasing tick: the number of ticks simulated (64 bits), the offset
+ *    of the next vector in the vectors file (64 bits), then the flip-flops and the outputs, each
+ *    starting on a byte boundary, with 2 bits per value as in the binary vectors files.
+ * Numbers are little-endian.
+ *
+ * Records are written by a background thread, and files are memory-mapped to find one.
+ */
+namespace checkpoint {
+	struct Snapshot {
+		uint64_t tick = 0, offset = 0;
+		std::vector<TruthValue> state, outputs;
+	};
+
+	class Writer {
+		std::ofstream file;
+		std::string record; // Being filled
+		std::unique_ptr<BackgroundWriter> background;
+
+		void begin(uint64_t tick, uint64_t offset);
+		template <class Values>
+		void pack(const Values &values) {
+			size_t start = record.size();
+			record.resize(start + (values.size() + 3) / 4);
+			for (size_t i = 0; i < values.size(); i++)
+				record[start + i / 4] |= char(TruthValue(values[i]).code() << (2 * (i % 4)));
+		}
+
+	  public:
+		Writer(const std::string &path, const ast::Module &module);
+
+		// The snapshot after `tick` ticks, when the next vector is at `offset`
+		template <class State, class Outputs>
+		void save(uint64_t tick, uint64_t offset, const State &state, const Outputs &outputs) {
+			begin(tick, offset);
+			pack(state);
+			pack(outputs);
+			background->write(record);
+		}
+	};
+
+	// The latest snapshot in the file taken at or before `tick`
+	Snapshot load(const std::string &path, const ast::Module &module, uint64_t tick = UINT64_MAX);
+} // namespace checkpoint
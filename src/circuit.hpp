@@ -3,7 +3,7 @@ void GenericSimulator<T, Implementation>::Circuit::evaluate(const std::vector<T>
 	if (inputs.size() != module.input_size())
 		throw "Input size mismatch"s;
 
-	std::vector<T> state_buffer = _state;
+	Values state_buffer = _state;
 
 	// Note that state is implicitly preserved across loops.
 	for (const ast::Assignment &assignment : module.assignments) {
@@ -0,0 +1,92 @@
+template <typename T, class Implementation>
+GenericSimulator<T, Implementation>::CompiledCircuit::CompiledCircuit(bytecode::Program program,
+                                                                      Implementation &impl)
+    : program(std::move(program)), values(this->program.slot_count), impl(impl) {
+	STATS_TIME(CONSTRUCTION);
+	std::vector<T> state(this->program.state_size);
+	impl.initialize(state);
+	std::copy(state.begin(), state.end(), values.begin() + this->program.state_base());
+}
+
+// Levels with fewer instructions than this are not worth waking up the threads for
+static constexpr size_t MIN_PARALLEL_LEVEL_SIZE = 4096;
+
+template <typename T, class Implementation>
+bool GenericSimulator<T, Implementation>::CompiledCircuit::parallelizable() {
+	if (program.levels.empty())
+		bytecode::levelize(program);
+	for (size_t level = 0; level + 1 < program.levels.size(); level++) {
+		uint32_t first = program.blocks[program.levels[level]];
+		uint32_t last = program.blocks[program.levels[level + 1]];
+		if (last - first >= MIN_PARALLEL_LEVEL_SIZE)
+			return true;
+	}
+	return false;
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::CompiledCircuit::parallelize(ThreadPool &pool) {
+	if (program.levels.empty())
+		bytecode::levelize(program);
+	steps = bytecode::schedule(program, pool.size(), MIN_PARALLEL_LEVEL_SIZE);
+	this->pool = &pool;
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::CompiledCircuit::evaluate(const std::vector<T> &inputs) {
+	if (inputs.size() != program.input_size)
+		throw "Input size mismatch"s;
+	std::copy(inputs.begin(), inputs.end(), values.begin());
+	STATS_ADD(evaluations, program.code.size());
+	T *slots = values.data();
+	if (pool == nullptr)
+		return bytecode::execute(program, slots, impl);
+
+	for (const std::vector<bytecode::Range> &step : steps) {
+		if (step.size() == 1)
+			bytecode::execute(program, step[0], slots, impl);
+		else
+			pool->parallel_for(step.size(), [&](size_t i) {
+				bytecode::execute(program, step[i], slots, impl);
+			});
+	}
+	bytecode::latch(program, slots);
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::CompiledCircuit::restore(const std::vector<T> &state,
+                                                                   const std::vector<T> &outputs) {
+	std::copy(state.begin(), state.end(), values.begin() + program.state_base());
+	std::copy(outputs.begin(), outputs.end(), values.begin() + program.output_base());
+}
+
+// Runs the instructions in `range` over the value buffer `slots`.
+template <typename T, class Implementation>
+ALWAYS_INLINE void bytecode::execute(const Program &program, Range range, T *slots,
+                                     Implementation &impl) {
+	// Flip-flops are read from the state slots and written to the flip-flop input slots, so the
+	// instructions always see the state from the previous tick.
+	const Instruction *code = program.code.data();
+	for (uint32_t i = range.first; i < range.last; i++) {
+		const Instruction &instruction = code[i];
+		if (instruction.opcode == Opcode::COPY)
+			slots[instruction.dst] = slots[instruction.lhs];
+		else
+			slots[instruction.dst] = impl.apply(to_operator(instruction.opcode),
+			                                    slots[instruction.lhs], slots[instruction.rhs]);
+	}
+}
+
+// Emulates a clock tick. Flip-flops that are never assigned keep their value.
+template <typename T>
+ALWAYS_INLINE void bytecode::latch(const Program &program, T *slots) {
+	for (const Latch &latch : program.latches)
+		slots[latch.to] = slots[latch.from];
+}
+
+// Runs a whole tick of the program over the value buffer `slots`.
+template <typename T, class Implementation>
+ALWAYS_INLINE void bytecode::execute(const Program &program, T *slots, Implementation &impl) {
+	execute(program, Range{0, uint32_t(program.code.size())}, slots, impl);
+	latch(program, slots);
+}
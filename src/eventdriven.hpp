@@ -0,0 +1,103 @@
+template <typename T, class Implementation>
+GenericSimulator<T, Implementation>::EventDrivenCircuit::EventDrivenCircuit(
+    bytecode::Program program, Implementation &impl)
+    : program(std::move(program)), values(this->program.slot_count),
+      pending((this->program.code.size() + 63) / 64), impl(impl) {
+	STATS_TIME(CONSTRUCTION);
+	std::vector<T> state(this->program.state_size);
+	impl.initialize(state);
+	std::copy(state.begin(), state.end(), values.begin() + this->program.state_base());
+
+	// Build the fan-out lists in compressed form: first count the readers of each slot, then
+	// turn the counts into offsets and fill in the instructions.
+	const std::vector<bytecode::Instruction> &code = this->program.code;
+	fanout_offsets.assign(this->program.slot_count + 1, 0);
+	for (const bytecode::Instruction &instruction : code) {
+		fanout_offsets[instruction.lhs + 1]++;
+		if (instruction.rhs != instruction.lhs)
+			fanout_offsets[instruction.rhs + 1]++;
+	}
+	for (size_t slot = 0; slot < this->program.slot_count; slot++)
+		fanout_offsets[slot + 1] += fanout_offsets[slot];
+	fanouts.resize(fanout_offsets.back());
+	std::vector<uint32_t> next = fanout_offsets;
+	for (uint32_t i = 0; i < code.size(); i++) {
+		fanouts[next[code[i].lhs]++] = i;
+		if (code[i].rhs != code[i].lhs)
+			fanouts[next[code[i].rhs]++] = i;
+	}
+
+	// Nothing has been computed yet
+	for (uint32_t i = 0; i < code.size(); i++)
+		schedule(i);
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::schedule(uint32_t instruction) {
+	pending[instruction / 64] |= uint64_t(1) << (instruction % 64);
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::set(uint32_t slot, T value) {
+	if (values[slot] == value)
+		return;
+	values[slot] = value;
+	for (uint32_t i = fanout_offsets[slot]; i < fanout_offsets[slot + 1]; i++)
+		schedule(fanouts[i]);
+}
+
+/* Instructions are in topological order and every slot is written at most once per tick, so the
+ * readers of a slot always come after its writer. Scanning the pending set in increasing order
+ * thus evaluates every instruction at most once, after all of its operands are final.
+ */
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::evaluate(
+    const std::vector<T> &inputs) {
+	if (inputs.size() != program.input_size)
+		throw "Input size mismatch"s;
+	for (uint32_t i = 0; i < inputs.size(); i++)
+		set(program.slot_of(ast::Input{i}), inputs[i]);
+	propagate();
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::update(uint32_t input, T value) {
+	set(program.slot_of(ast::Input{input}), value);
+	propagate();
+}
+
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::propagate() {
+	uint64_t evaluated = 0;
+	for (size_t word = 0; word < pending.size(); word++) {
+		while (pending[word] != 0) {
+			uint32_t index = word * 64 + __builtin_ctzll(pending[word]);
+			pending[word] &= pending[word] - 1;
+			const bytecode::Instruction &instruction = program.code[index];
+			if (instruction.opcode == bytecode::Opcode::COPY)
+				set(instruction.dst, values[instruction.lhs]);
+			else
+				set(instruction.dst, impl.apply(bytecode::to_operator(instruction.opcode),
+				                                values[instruction.lhs], values[instruction.rhs]));
+			evaluated++;
+		}
+	}
+	stats.ticks++;
+	stats.evaluated += evaluated;
+	stats.skipped += program.code.size() - evaluated;
+	STATS_ADD(evaluations, evaluated);
+
+	// Changes in the state are picked up in the next tick
+	for (const bytecode::Latch &latch : program.latches)
+		set(latch.to, values[latch.from]);
+}
+
+// Nothing that was computed from the old state can be trusted, so everything is evaluated again
+template <typename T, class Implementation>
+void GenericSimulator<T, Implementation>::EventDrivenCircuit::restore(
+    const std::vector<T> &state, const std::vector<T> &outputs) {
+	std::copy(state.begin(), state.end(), values.begin() + program.state_base());
+	std::copy(outputs.begin(), outputs.end(), values.begin() + program.output_base());
+	for (uint32_t i = 0; i < program.code.size(); i++)
+		schedule(i);
+}
@@ -0,0 +1,164 @@
+#include "exhaustive.h"
+#include "simulation.h"
+#include "stats.h"
+#include "threadpool.h"
+#include "utils.h"
+
+static constexpr TruthValue DIGITS[] = {TruthValue::FALSE, TruthValue::TRUE, TruthValue::X};
+static constexpr uint64_t MIN_SHARDS = 256;
+
+// The outputs that depend on each input, through a mask of the inputs that reach every slot
+static std::vector<std::vector<size_t>> cones(const bytecode::Program &program) {
+	std::vector<uint64_t> reach(program.slot_count, 0);
+	for (size_t i = 0; i < program.input_size; i++)
+		reach[program.slot_of(ast::Input{i})] = uint64_t(1) << i;
+	for (const bytecode::Instruction &instruction : program.code) {
+		bool unary = instruction.opcode == bytecode::Opcode::NOT ||
+		             instruction.opcode == bytecode::Opcode::COPY;
+		reach[instruction.dst] = reach[instruction.lhs] | (unary ? 0 : reach[instruction.rhs]);
+	}
+	std::vector<std::vector<size_t>> cones(program.input_size);
+	for (size_t i = 0; i < program.input_size; i++)
+		for (size_t output = 0; output < program.output_size; output++)
+			if (reach[program.slot_of(ast::Output{output})] >> i & 1)
+				cones[i].push_back(output);
+	return cones;
+}
+
+/* Counts the outputs of a shard by runs: every output keeps its value and the vector it was set
+ * at, and only the outputs that depend on the input that changed are checked for a new value.
+ * The others, and outputs that are never assigned and stay X, cost nothing per vector.
+ */
+class Tally {
+  public:
+	template <class Outputs>
+	Tally(exhaustive::Report &report, const Outputs &outputs) : report(report) {
+		report.histogram.resize(outputs.size());
+		for (size_t i = 0; i < outputs.size(); i++) {
+			values.push_back(outputs[i]);
+			x_outputs += outputs[i] == TruthValue::X;
+		}
+		since.assign(outputs.size(), 0);
+	}
+
+	// Counts the current vector, after the outputs in `changed` may have changed
+	template <class Outputs>
+	void add(const Outputs &outputs, const std::vector<size_t> &changed,
+	         const std::vector<TruthValue> &inputs) {
+		for (size_t i : changed) {
+			if (outputs[i] == values[i])
+				continue;
+			report.histogram[i][values[i].code()] += report.vectors - since[i];
+			x_outputs += (outputs[i] == TruthValue::X) - (values[i] == TruthValue::X);
+			values[i] = outputs[i];
+			since[i] = report.vectors;
+		}
+		report.vectors++;
+		if (x_outputs == 0)
+			return;
+		report.x_count++;
+		if (report.x_vectors.size() < exhaustive::Report::MAX_X_VECTORS) {
+			std::string vector;
+			for (TruthValue value : inputs)
+				vector += value.toChar();
+			report.x_vectors.push_back(vector);
+		}
+	}
+
+	// Counts the last run of every output
+	void finish() {
+		for (size_t i = 0; i < values.size(); i++)
+			report.histogram[i][values[i].code()] += report.vectors - since[i];
+	}
+
+  private:
+	exhaustive::Report &report;
+	std::vector<TruthValue> values;
+	std::vector<uint64_t> since;
+	size_t x_outputs = 0;
+};
+
+exhaustive::Report exhaustive::run(const bytecode::Program &program, unsigned radix,
+                                   size_t threads) {
+	if (program.state_size != 0)
+		throw "Exhaustive simulation needs a circuit without flip-flops"s;
+	size_t inputs = program.input_size;
+	uint64_t vectors = 1;
+	for (size_t i = 0; i < inputs; i++) {
+		if (vectors > UINT64_MAX / radix)
+			throw "Too many inputs to enumerate"s;
+		vectors *= radix;
+	}
+
+	// Enough shards for the threads to balance the load, each with the last `fixed` inputs set. The
+	// split doesn't depend on the threads, so neither does the order of the vectors with an X.
+	size_t fixed = 0;
+	uint64_t shards = 1;
+	for (; fixed < inputs && shards < MIN_SHARDS; fixed++)
+		shards *= radix;
+	size_t free = inputs - fixed;
+
+	std::vector<Report> partial(shards);
+	std::vector<std::vector<size_t>> cones = ::cones(program);
+	ThreadPool pool(threads);
+	simulation::Implementation impl;
+	pool.parallel_for(shards, [&](size_t shard) {
+		STATS_TICKS(vectors / shards);
+		std::vector<TruthValue> values(inputs, TruthValue::FALSE);
+		for (size_t i = free, rest = shard; i < inputs; i++, rest /= radix)
+			values[i] = DIGITS[rest % radix];
+		simulation::EventDrivenCircuit ckt(program, impl);
+		ckt.evaluate(values);
+		Tally tally(partial[shard], ckt.outputs());
+
+		// Every step moves the first digit that isn't at the end of its direction, and reverses
+		// the ones before it
+		std::vector<unsigned> digits(free, 0);
+		std::vector<int> directions(free, 1);
+		const std::vector<size_t> none;
+		const std::vector<size_t> *changed = &none;
+		while (true) {
+			tally.add(ckt.outputs(), *changed, values);
+			size_t i = 0;
+			for (; i < free && digits[i] == (directions[i] > 0 ? radix - 1 : 0); i++)
+				directions[i] = -directions[i];
+			if (i == free)
+				break;
+			digits[i] += directions[i];
+			values[i] = DIGITS[digits[i]];
+			ckt.update(i, values[i]);
+			changed = &cones[i];
+		}
+		tally.finish();
+	});
+
+	Report report;
+	report.histogram.resize(program.output_size);
+	for (const Report &part : partial) {
+		report.vectors += part.vectors;
+		for (size_t i = 0; i < program.output_size; i++)
+			for (size_t value = 0; value < 3; value++)
+				report.histogram[i][value] += part.histogram[i][value];
+		report.x_count += part.x_count;
+		for (const std::string &vector : part.x_vectors)
+			if (report.x_vectors.size() < Report::MAX_X_VECTORS)
+				report.x_vectors.push_back(vector);
+	}
+	return report;
+}
+
+void exhaustive::write(std::ostream &out, const ast::Module &module, const Report &report) {
+	out << "Exhaustive simulation: " << report.vectors << " vectors\n";
+	out << "Output\t0\t1\tx\n";
+	for (size_t i = 0; i < report.histogram.size(); i++) {
+		const auto &counts = report.histogram[i];
+		out << module.name_of(ast::Output{i}) << '\t' << counts[0] << '\t' << counts[1] << '\t'
+		    << counts[2] << '\n';
+	}
+	out << "Vectors with an X output: " << report.x_count << '\n';
+	if (!report.x_vectors.empty())
+		out << "The first ones:\n";
+	for (const std::string &vector : report.x_vectors)
+		out << '\t' << vector << '\n';
+	out << std::flush;
+}
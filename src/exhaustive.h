@@ -0,0 +1,34 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Simulates every combination of the inputs of a circuit without flip-flops, without a vectors
+ * file, and sums up the outputs instead of printing them.
+ *
+ * The combinations are split into shards by the values of the last inputs. Within a shard, the
+ * others follow a reflected Gray code, so consecutive vectors differ by a single input and the
+ * event-driven engine only evaluates the gates that depend on it.
+ */
+namespace exhaustive {
+	struct Report {
+		static constexpr size_t MAX_X_VECTORS = 10;
+
+		uint64_t vectors = 0;
+		// How many vectors set each output to 0, 1 and X
+		std::vector<std::array<uint64_t, 3>> histogram;
+		// The vectors with an X output, and the first ones in enumeration order
+		uint64_t x_count = 0;
+		std::vector<std::string> x_vectors;
+	};
+
+	// `radix` is 2 to enumerate 0 and 1, or 3 to add X. Outputs can be X with either one, eg. if
+	// they are never assigned.
+	Report run(const bytecode::Program &, unsigned radix, size_t threads);
+	void write(std::ostream &, const ast::Module &, const Report &);
+} // namespace exhaustive
@@ -1,7 +1,7 @@
 template <typename T, class Implementation>
 T GenericSimulator<T, Implementation>::StackMachine::evaluate(const std::vector<T> &inputs,
-                                                              const std::vector<T> &state,
-                                                              const std::vector<T> &outputs) {
+                                                              const Values &state,
+                                                              const Values &outputs) {
 	while (!expression.empty()) {
 		ast::Token token = pop_back(expression);
 		if (is_input(token)) {
@@ -13,10 +13,12 @@ T GenericSimulator<T, Implementation>::StackMachine::evaluate(const std::vector<
 		} else if (is_operator(token)) {
 			auto astOperator = get_operator(token);
 			impl.on_operator(astOperator, operandStack);
+			STATS_ADD(evaluations, 1);
 		} else if (is_output(token)) {
 			size_t index = get_output(token).offset;
 			operandStack.push(outputs[index]);
 		}
+		STATS_MAX(max_stack_depth, operandStack.size());
 	}
 	if (operandStack.empty())
 		throw "The operand stack is empty"s;
@@ -0,0 +1,256 @@
+#include "faults.h"
+#include "bitparallel.h"
+#include "threadpool.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+static constexpr uint32_t NONE = UINT32_MAX;
+
+std::vector<faults::Fault> faults::enumerate(const bytecode::Program &program) {
+	std::vector<uint32_t> sites;
+	for (uint32_t slot = 0; slot < program.input_size + program.state_size; slot++)
+		sites.push_back(slot);
+	for (const bytecode::Instruction &instruction : program.code)
+		sites.push_back(instruction.dst);
+	std::vector<Fault> faults;
+	for (uint32_t slot : sites) {
+		faults.push_back({slot, false});
+		faults.push_back({slot, true});
+	}
+	return faults;
+}
+
+// Sets every lane of a slot to `value`
+static void broadcast(bitparallel::Buffer &buffer, uint32_t slot, TruthValue value) {
+	size_t words = buffer.lanes() / 64;
+	uint64_t *one = buffer.data() + 2 * slot * words;
+	std::fill(one, one + words, value == TruthValue::TRUE ? ~uint64_t(0) : 0);
+	std::fill(one + words, one + 2 * words, value == TruthValue::FALSE ? ~uint64_t(0) : 0);
+}
+
+// A copy of a program that forces the slots of some faults in lanes 1 to faults.size(), and the
+// buffer to run it on
+struct Injected {
+	bytecode::Program program;
+	bitparallel::Buffer buffer;
+	size_t faults;
+	std::vector<uint64_t> differ; // The lanes that differ from the good machine
+};
+
+static Injected inject(const bytecode::Program &program, const kernels::Kernel &kernel,
+                       const std::vector<faults::Fault> &faults) {
+	// The slots of the masks that force each slot to 0 and to 1, if any
+	bytecode::Program faulty = program;
+	std::vector<uint32_t> masks[2];
+	masks[0].assign(program.slot_count, NONE);
+	masks[1].assign(program.slot_count, NONE);
+	for (const faults::Fault &fault : faults)
+		if (masks[fault.value][fault.slot] == NONE)
+			masks[fault.value][fault.slot] = faulty.slot_count++;
+
+	auto inject = [&](uint32_t slot) {
+		if (masks[0][slot] != NONE)
+			faulty.code.push_back({bytecode::Opcode::AND, slot, slot, masks[0][slot]});
+		if (masks[1][slot] != NONE)
+			faulty.code.push_back({bytecode::Opcode::OR, slot, slot, masks[1][slot]});
+	};
+	faulty.code.clear();
+	for (uint32_t slot = 0; slot < program.input_size + program.state_size; slot++)
+		inject(slot);
+	for (const bytecode::Instruction &instruction : program.code) {
+		faulty.code.push_back(instruction);
+		inject(instruction.dst);
+	}
+	faulty.blocks = {0, uint32_t(faulty.code.size())};
+
+	bitparallel::Buffer buffer(faulty.slot_count, kernel.words);
+	for (uint32_t slot = program.slot_count; slot < faulty.slot_count; slot++)
+		broadcast(buffer, slot, TruthValue::TRUE);
+	for (uint32_t slot = 0; slot < program.slot_count; slot++)
+		if (masks[1][slot] != NONE)
+			broadcast(buffer, masks[1][slot], TruthValue::FALSE);
+	for (size_t i = 0; i < faults.size(); i++) {
+		const faults::Fault &fault = faults[i];
+		buffer.set(masks[fault.value][fault.slot], i + 1, fault.value);
+	}
+	return {std::move(faulty), std::move(buffer), faults.size(),
+	        std::vector<uint64_t>(kernel.words)};
+}
+
+// Runs a vector, and calls `detect(i)` for every fault i whose lane has an output that is 0 or 1 in
+// the good machine and the opposite there
+template <class Detect>
+static void step(const bytecode::Program &program, const kernels::Kernel &kernel,
+                 Injected &injected, const vectorio::Vector &vector, Detect detect) {
+	for (size_t i = 0; i < program.input_size; i++)
+		broadcast(injected.buffer, program.slot_of(ast::Input{i}), vector[i]);
+	{
+		STATS_TICKS(1);
+		kernel.execute(injected.program, injected.buffer.data());
+	}
+	STATS_ADD(evaluations, injected.program.code.size() * (injected.faults + 1));
+
+	size_t words = kernel.words;
+	std::vector<uint64_t> &differ = injected.differ;
+	std::fill(differ.begin(), differ.end(), 0);
+	for (size_t i = 0; i < program.output_size; i++) {
+		const uint64_t *one = injected.buffer.data() + 2 * program.slot_of(ast::Output{i}) * words;
+		const uint64_t *zero = one + words;
+		// The rail where the good value can't be
+		const uint64_t *opposite = (one[0] & 1) ? zero : (zero[0] & 1) ? one : nullptr;
+		if (opposite)
+			for (size_t word = 0; word < words; word++)
+				differ[word] |= opposite[word];
+	}
+	for (size_t word = 0; word < words; word++)
+		for (uint64_t bits = differ[word]; bits != 0; bits &= bits - 1) {
+			size_t lane = word * 64 + __builtin_ctzll(bits);
+			if (lane != 0 && lane <= injected.faults)
+				detect(lane - 1);
+		}
+}
+
+// Simulates a group of faults from the first vector until they are all detected. With flip-flops a
+// fault depends on the vectors before, so it can't take the lane of one detected halfway through.
+static void simulate(const bytecode::Program &program, const kernels::Kernel &kernel,
+                     const std::vector<vectorio::Vector> &vectors,
+                     const std::vector<faults::Fault> &faults, uint64_t *detected_at) {
+	Injected injected = inject(program, kernel, faults);
+	size_t remaining = faults.size();
+	for (uint64_t tick = 0; tick < vectors.size() && remaining > 0; tick++)
+		step(program, kernel, injected, vectors[tick], [&](size_t i) {
+			if (detected_at[i] == faults::Report::UNDETECTED) {
+				detected_at[i] = tick;
+				remaining--;
+			}
+		});
+}
+
+/* Simulates the faults handed out by `next` until there are none left, for circuits without
+ * flip-flops. Vectors don't depend on each other, so they go around in a circle and every fault
+ * is done once it is detected or it has seen all of them, wherever it started. When half of the
+ * lanes are done, the program is rebuilt with the faults left and new ones in the free lanes.
+ */
+static void simulate_refilling(const bytecode::Program &program, const kernels::Kernel &kernel,
+                               const std::vector<vectorio::Vector> &vectors,
+                               const std::vector<faults::Fault> &faults, std::atomic<size_t> &next,
+                               uint64_t *detected_at) {
+	size_t capacity = kernel.lanes() - 1, tick = 0;
+	// The faults in the lanes, and how many vectors each one has seen
+	std::vector<size_t> lanes;
+	std::vector<uint64_t> seen;
+	while (true) {
+		for (size_t i; lanes.size() < capacity && (i = next++) < faults.size();) {
+			lanes.push_back(i);
+			seen.push_back(0);
+		}
+		if (lanes.empty())
+			return;
+
+		std::vector<faults::Fault> batch;
+		for (size_t i : lanes)
+			batch.push_back(faults[i]);
+		Injected injected = inject(program, kernel, batch);
+		std::vector<bool> done(lanes.size(), false);
+		size_t live = lanes.size();
+		while (2 * live > lanes.size()) {
+			step(program, kernel, injected, vectors[tick], [&](size_t lane) {
+				if (!done[lane]) {
+					detected_at[lanes[lane]] = tick;
+					done[lane] = true;
+					live--;
+				}
+			});
+			for (size_t lane = 0; lane < lanes.size(); lane++)
+				if (!done[lane] && ++seen[lane] == vectors.size()) {
+					done[lane] = true;
+					live--;
+				}
+			tick = (tick + 1) % vectors.size();
+		}
+
+		size_t kept = 0;
+		for (size_t lane = 0; lane < lanes.size(); lane++)
+			if (!done[lane]) {
+				lanes[kept] = lanes[lane];
+				seen[kept++] = seen[lane];
+			}
+		lanes.resize(kept);
+		seen.resize(kept);
+	}
+}
+
+faults::Report faults::run(const bytecode::Program &program, const kernels::Kernel &kernel,
+                           vectorio::VectorReader &vectors, size_t threads) {
+	// Every fault goes through all of the vectors
+	std::vector<vectorio::Vector> all;
+	vectorio::Vector vector;
+	while (vectors.next(vector)) {
+		if (vector.size() != program.input_size)
+			throw "Input size mismatch (line " + std::to_string(all.size()) + ")";
+		all.push_back(vector);
+	}
+
+	Report report;
+	report.vectors = all.size();
+	report.faults = enumerate(program);
+	report.detected_at.assign(report.faults.size(), Report::UNDETECTED);
+	if (all.empty())
+		return report;
+	ThreadPool pool(threads);
+	if (program.state_size == 0) {
+		std::atomic<size_t> next{0};
+		pool.parallel_for(pool.size(), [&](size_t) {
+			simulate_refilling(program, kernel, all, report.faults, next,
+			                   report.detected_at.data());
+		});
+		return report;
+	}
+	size_t group_size = kernel.lanes() - 1;
+	size_t groups = (report.faults.size() + group_size - 1) / group_size;
+	pool.parallel_for(groups, [&](size_t group) {
+		size_t first = group * group_size;
+		size_t last = std::min(first + group_size, report.faults.size());
+		std::vector<Fault> faults(report.faults.begin() + first, report.faults.begin() + last);
+		simulate(program, kernel, all, faults, report.detected_at.data() + first);
+	});
+	return report;
+}
+
+void faults::write(std::ostream &out, const ast::Module &module, const bytecode::Program &program,
+                   const Report &report) {
+	std::vector<std::string> names(program.slot_count);
+	for (size_t i = 0; i < module.input_size(); i++)
+		names[program.slot_of(ast::Input{i})] = module.name_of(ast::Input{i});
+	for (size_t i = 0; i < module.state_size(); i++) {
+		names[program.slot_of(ast::Flipflop{i})] = module.name_of(ast::Flipflop{i});
+		names[program.next_state_slot(ast::Flipflop{i})] = module.name_of(ast::Flipflop{i}) + ".d";
+	}
+	for (size_t i = 0; i < module.output_size(); i++)
+		names[program.slot_of(ast::Output{i})] = module.name_of(ast::Output{i});
+	for (size_t block = 0; block + 1 < program.blocks.size(); block++) {
+		std::string lvalue = std::visit(
+		    [&](auto &&token) { return module.name_of(token); }, module.assignments[block].lvalue);
+		size_t gates = 0;
+		for (uint32_t i = program.blocks[block]; i < program.blocks[block + 1]; i++)
+			if (program.is_temporary(program.code[i].dst))
+				names[program.code[i].dst] = lvalue + ".g" + std::to_string(gates++);
+	}
+
+	size_t detected = report.faults.size() -
+	                  std::count(report.detected_at.begin(), report.detected_at.end(),
+	                             Report::UNDETECTED);
+	double coverage = report.faults.empty() ? 100 : 100.0 * detected / report.faults.size();
+	out << "Fault simulation: " << report.vectors << " vectors, " << report.faults.size()
+	    << " stuck-at faults, " << detected << " detected (" << std::fixed << std::setprecision(2)
+	    << coverage << "% coverage)\n";
+	if (detected < report.faults.size())
+		out << "Undetected faults:\n";
+	for (size_t i = 0; i < report.faults.size(); i++)
+		if (report.detected_at[i] == Report::UNDETECTED)
+			out << '\t' << names[report.faults[i].slot] << " stuck-at " << report.faults[i].value
+			    << '\n';
+	out << std::flush;
+}
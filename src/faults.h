@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ast.h"
+#include "bytecode.h"
+#include "kernels.h"
+#include "vectorio.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/* Grades a set of vectors by the stuck-at faults that it detects: every input, flip-flop and gate
+ * of the compiled (unoptimized) program stuck at 0 and at 1.
+ *
+ * Faults are simulated in groups, one per lane of a bit-parallel kernel, with the good machine in
+ * lane 0. A copy of the program forces each faulty slot right after it is written, by AND-ing or
+ * OR-ing it with a mask slot that is only 0 or 1 in the lanes of its faults. A fault is detected
+ * when an output is 0 or 1 in the good machine and the opposite in its lane.
+ *
+ * Without flip-flops, vectors are independent: a lane whose fault was detected takes a pending one,
+ * which goes around the vectors from where it joined. With flip-flops, a fault has to start from
+ * the first vector, so faults are simulated in fixed groups that stop once all of their faults are
+ * detected, and the lanes of the ones detected early stay idle until then. Either way the work runs
+ * on `threads` threads (0: one per core).
+ */
+namespace faults {
+	// `slot` of the program always holds `value`
+	struct Fault {
+		uint32_t slot;
+		bool value;
+	};
+
+	struct Report {
+		static constexpr uint64_t UNDETECTED = UINT64_MAX;
+
+		uint64_t vectors = 0;
+		std::vector<Fault> faults;
+		// The index of a vector that detected each fault, or UNDETECTED. With flip-flops it's the
+		// first one.
+		std::vector<uint64_t> detected_at;
+	};
+
+	std::vector<Fault> enumerate(const bytecode::Program &);
+	Report run(const bytecode::Program &, const kernels::Kernel &, vectorio::VectorReader &vectors,
+	           size_t threads);
+	// Prints the coverage and the faults that weren't detected. Gates are named after the
+	// assignment that computes them: "x.d" is the input of flip-flop x and "x.g2" the third gate of
+	// the expression assigned to x.
+	void write(std::ostream &, const ast::Module &, const bytecode::Program &, const Report &);
+} // namespace faults
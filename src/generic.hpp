@@ -1,11 +1,15 @@
 #pragma once
 
 #include "ast.h"
+#include "bytecode.h"
+#include "stats.h"
+#include "threadpool.h"
 
 template <typename T, class Implementation>
 class GenericSimulator {
   public:
 	using OperandStack = std::stack<T>;
+	using Values = typename ValueVector<T>::type;
 
 	class StackMachine {
 		ast::Expression expression;
@@ -16,14 +20,13 @@ class GenericSimulator {
 	  public:
 		StackMachine(const ast::Expression &expr, Implementation &impl)
 		    : expression(expr), impl(impl) {}
-		T evaluate(const std::vector<T> &inputs, const std::vector<T> &state,
-		           const std::vector<T> &outputs);
+		T evaluate(const std::vector<T> &inputs, const Values &state, const Values &outputs);
 	};
 
 	class Circuit {
 		ast::Module module;
-		std::vector<T> _state;
-		std::vector<T> _outputs;
+		Values _state;
+		Values _outputs;
 
 		Implementation &impl;
 
@@ -31,15 +34,98 @@ class GenericSimulator {
 		Circuit(ast::Module module, Implementation &impl)
 		    : module(module), _state(module.state_size()), _outputs(module.output_size()),
 		      impl(impl) {
-			impl.initialize(_state);
+			STATS_TIME(CONSTRUCTION);
+			std::vector<T> state(module.state_size());
+			impl.initialize(state);
+			_state.assign(state.begin(), state.end());
 		}
 
 		void evaluate(const std::vector<T> &inputs);
+		// Replaces the state and the outputs, eg. to resume from a checkpoint
+		void restore(const std::vector<T> &state, const std::vector<T> &outputs) {
+			_state.assign(state.begin(), state.end());
+			_outputs.assign(outputs.begin(), outputs.end());
+		}
+
+		const Values &state() const { return _state; };
+		const Values &outputs() const { return _outputs; };
+	};
+
+	// Runs a bytecode::Program rather than interpreting the expressions of the module.
+	// Requires Implementation::apply, which evaluates a single operator.
+	class CompiledCircuit {
+		bytecode::Program program;
+		std::vector<T> values;
+
+		Implementation &impl;
+
+		ThreadPool *pool = nullptr;
+		std::vector<std::vector<bytecode::Range>> steps;
 
-		const std::vector<T> &state() const { return _state; };
-		const std::vector<T> &outputs() const { return _outputs; };
+	  public:
+		CompiledCircuit(bytecode::Program program, Implementation &impl);
+
+		// Whether some level is large enough for parallelize() to split it. Levelizes the program.
+		bool parallelizable();
+		// From now on, evaluate the independent assignments of each level concurrently on `pool`.
+		// Implementation::apply must be thread-safe.
+		void parallelize(ThreadPool &pool);
+		void evaluate(const std::vector<T> &inputs);
+		void restore(const std::vector<T> &state, const std::vector<T> &outputs);
+
+		Slice<T> state() const {
+			return {values.data() + program.state_base(), values.data() + program.output_base()};
+		}
+		Slice<T> outputs() const {
+			return {values.data() + program.output_base(),
+			        values.data() + program.output_base() + program.output_size};
+		}
+	};
+
+	// Runs a bytecode::Program like CompiledCircuit, but each tick only evaluates the instructions
+	// whose operands changed since the previous tick. Requires T::operator==.
+	class EventDrivenCircuit {
+		bytecode::Program program;
+		std::vector<T> values;
+
+		// The instructions that read slot i are fanouts[fanout_offsets[i], fanout_offsets[i + 1])
+		std::vector<uint32_t> fanout_offsets;
+		std::vector<uint32_t> fanouts;
+		// A bitset of the instructions to evaluate
+		std::vector<uint64_t> pending;
+
+		Implementation &impl;
+
+		void schedule(uint32_t instruction);
+		// Writes a slot, and schedules its readers if the value changed
+		void set(uint32_t slot, T value);
+		// Evaluates the pending instructions and latches the state
+		void propagate();
+
+	  public:
+		struct Statistics {
+			uint64_t ticks = 0;
+			uint64_t evaluated = 0, skipped = 0;
+		} stats;
+
+		EventDrivenCircuit(bytecode::Program program, Implementation &impl);
+
+		void evaluate(const std::vector<T> &inputs);
+		// Like evaluate() with the previous inputs but for one, only cheaper
+		void update(uint32_t input, T value);
+		void restore(const std::vector<T> &state, const std::vector<T> &outputs);
+
+		Slice<T> state() const {
+			return {values.data() + program.state_base(), values.data() + program.output_base()};
+		}
+		Slice<T> outputs() const {
+			return {values.data() + program.output_base(),
+			        values.data() + program.output_base() + program.output_size};
+		}
 	};
 };
 
 #include "circuit.hpp"
+#include "compiled.hpp"
+#include "eventdriven.hpp"
 #include "expression.hpp"
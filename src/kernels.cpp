@@ -0,0 +1,52 @@
+#include "kernels.h"
+#include "bitparallel.h"
+
+using namespace kernels;
+
+/* Every kernel is the same bit-parallel code instantiated on a different word type. The SIMD ones
+ * use GCC/Clang vector types, and are compiled for their instruction set with the `target`
+ * attribute: everything they call is ALWAYS_INLINE, so it is compiled for that instruction set too.
+ */
+template <typename Word>
+ALWAYS_INLINE static void execute(const bytecode::Program &program, uint64_t *values) {
+	bitparallel::Implementation<Word> impl;
+	auto *slots = reinterpret_cast<bitparallel::PackedTruthValue<Word> *>(values);
+	bytecode::execute(program, slots, impl);
+}
+
+static void execute_scalar(const bytecode::Program &program, uint64_t *values) {
+	execute<uint64_t>(program, values);
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define HAVE_X86_KERNELS
+typedef uint64_t Word256 __attribute__((vector_size(32)));
+typedef uint64_t Word512 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2"))) static void execute_avx2(const bytecode::Program &program,
+                                                         uint64_t *values) {
+	execute<Word256>(program, values);
+}
+
+__attribute__((target("avx512f"))) static void execute_avx512(const bytecode::Program &program,
+                                                              uint64_t *values) {
+	execute<Word512>(program, values);
+}
+#endif
+
+const std::vector<Kernel> &kernels::available() {
+	static const std::vector<Kernel> kernels = [] {
+		std::vector<Kernel> ret{{"scalar", 1, execute_scalar}};
+#ifdef HAVE_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			ret.push_back({"avx2", 4, execute_avx2});
+		if (__builtin_cpu_supports("avx512f"))
+			ret.push_back({"avx512", 8, execute_avx512});
+#endif
+		return ret;
+	}();
+	return kernels;
+}
+
+const Kernel &kernels::widest() { return available().back(); }
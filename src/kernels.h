@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bytecode.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Kernels run a bytecode::Program over a bitparallel::Buffer, processing 64 * `words` vectors per
+ * gate evaluation. Wider kernels use SIMD registers and are only offered if the CPU supports them;
+ * the scalar kernel works everywhere.
+ */
+namespace kernels {
+	struct Kernel {
+		std::string name;
+		size_t words; // 64-bit words per rail
+		std::function<void(const bytecode::Program &, uint64_t *values)> execute;
+
+		size_t lanes() const { return 64 * words; }
+	};
+
+	// The kernels supported by this CPU, from the narrowest to the widest
+	const std::vector<Kernel> &available();
+	const Kernel &widest();
+} // namespace kernels
@@ -1,43 +1,148 @@
 #include "analysis.h"
 #include "parser.h"
 #include "simulation.h"
-#include <fstream>
+#include "stats.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 
 int main(int argc, char **argv) {
-	if (argc != 2) {
-		std::cerr << "Syntax: " << argv[0] << " <input file>" << std::endl;
+	std::string filename;
+	char choice = 0;
+	simulation::Options options;
+	bool syntax_error = false, print_stats = false;
+	for (int i = 1; i < argc && !syntax_error; i++) {
+		std::string arg = argv[i];
+		if ((arg == "-j" || arg == "--threads") && i + 1 < argc)
+			options.threads = std::strtoul(argv[++i], nullptr, 10);
+		else if (arg == "--no-optimize")
+			options.optimize = false;
+		else if (arg == "--exhaustive")
+			options.exhaustive = 2;
+		else if (arg == "--exhaustive-x")
+			options.exhaustive = 3;
+		else if (arg == "--faults")
+			options.fault_simulation = true;
+		else if (arg == "--no-cycle-detection")
+			options.detect_cycles = false;
+		else if (arg == "--verbose" || arg == "-v")
+			options.verbose = true;
+		else if (arg == "--stats")
+			print_stats = true;
+		else if (arg == "--engine" && i + 1 < argc) {
+			using Evaluator = simulation::Options::Evaluator;
+			std::string engine = argv[++i];
+			if (engine == "auto")
+				options.evaluator = Evaluator::AUTO;
+			else if (engine == "interpreted")
+				options.evaluator = Evaluator::INTERPRETED;
+			else if (engine == "compiled")
+				options.evaluator = Evaluator::COMPILED;
+			else if (engine == "bitparallel")
+				options.evaluator = Evaluator::BIT_PARALLEL;
+			else if (engine == "event")
+				options.evaluator = Evaluator::EVENT_DRIVEN;
+			else if (engine == "native")
+				options.evaluator = Evaluator::NATIVE;
+			else
+				syntax_error = true;
+		} else if (arg == "--mode" && i + 1 < argc) {
+			std::string mode = argv[++i];
+			if (mode == "simulation" || mode == "s")
+				choice = 'S';
+			else if (mode == "analysis" || mode == "a")
+				choice = 'A';
+			else
+				syntax_error = true;
+		} else if (arg == "--vectors" && i + 1 < argc)
+			options.vectors = argv[++i];
+		else if (arg == "--output" && i + 1 < argc)
+			options.output = argv[++i];
+		else if (arg == "--vcd" && i + 1 < argc)
+			options.vcd = argv[++i];
+		else if (arg == "--vcd-signals" && i + 1 < argc) {
+			// Comma-separated
+			std::string_view signals = argv[++i];
+			while (!signals.empty()) {
+				size_t end = std::min(signals.find(','), signals.size());
+				options.vcd_signals.emplace_back(signals.substr(0, end));
+				signals.remove_prefix(std::min(end + 1, signals.size()));
+			}
+		} else if (arg == "--checkpoint" && i + 1 < argc)
+			options.checkpoints = argv[++i];
+		else if (arg == "--checkpoint-every" && i + 1 < argc)
+			options.checkpoint_interval = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--resume" && i + 1 < argc)
+			options.resume = argv[++i];
+		else if (arg == "--resume-at" && i + 1 < argc)
+			options.resume_tick = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--output-format" && i + 1 < argc) {
+			std::string format = argv[++i];
+			if (format == "text")
+				options.output_format = vectorio::Format::TEXT;
+			else if (format == "binary")
+				options.output_format = vectorio::Format::BINARY;
+			else
+				syntax_error = true;
+		} else if (filename.empty() && arg[0] != '-')
+			filename = arg;
+		else
+			syntax_error = true;
+	}
+	if (syntax_error || filename.empty()) {
+		std::cerr << "Syntax: " << argv[0]
+		          << " [--mode simulation|analysis] [--vectors FILE] [--output FILE]"
+		             " [--output-format text|binary] [--vcd FILE] [--vcd-signals A,B,...]"
+		             " [--checkpoint FILE] [--checkpoint-every N] [--resume FILE]"
+		             " [--resume-at TICK] [--exhaustive|--exhaustive-x] [--faults] [--threads N]"
+		             " [--engine auto|interpreted|compiled|bitparallel|event|native]"
+		             " [--no-optimize] [--no-cycle-detection] [--verbose] [--stats]"
+		             " <input file>"
+		          << std::endl;
 		return 1;
 	}
+	if (print_stats) {
+		if (!stats::ENABLED) {
+			std::cerr << "--stats requires a build with -DSTATS=ON" << std::endl;
+			return 1;
+		}
+		// Printed on stderr at exit, even after an error
+		std::atexit([]() { stats::write_json(std::cerr); });
+	}
 
-	std::string filename = argv[1];
 	ast::Module module;
+	// Will be automatically unmapped because of RAII
+	std::unique_ptr<vectorio::MappedFile> file;
 	try {
-		// Will be automatically closed because of RAII
-		std::ifstream file_str(filename);
-		if (file_str.fail()) {
-			std::cerr << "Failed to read file." << std::endl;
-			return 1;
-		}
-		FileParser parser(file_str);
+		file = std::make_unique<vectorio::MappedFile>(filename);
+	} catch (std::string &) {
+		std::cerr << "Failed to read file." << std::endl;
+		return 1;
+	}
+	try {
+		FileParser parser(file->contents(), options.threads);
 		module = parser.finalize();
 	} catch (std::string &e) {
 		std::cerr << "An error occurred while parsing " + filename + ": " << e << std::endl;
 		return 1;
 	}
 
-	std::cout << "Please select a mode of operation ([S]imulation/[A]nalysis, default: S): ";
-	char choice;
-	if (std::cin.peek() == '\n')
-		choice = 'S';
-	else
-		std::cin >> choice;
+	// Without --mode, everything that is missing is asked interactively
+	if (choice == 0) {
+		std::cout << "Please select a mode of operation ([S]imulation/[A]nalysis, default: S): ";
+		if (std::cin.peek() == '\n')
+			choice = 'S';
+		else
+			std::cin >> choice;
+		std::cin.ignore(); // Skip the newline that's left in the buffer
+	}
 
 	switch (choice) {
 		case 'S':
 		case 's':
 			try {
-				simulation::run(module);
+				simulation::run(module, options);
 			} catch (std::string &e) {
 				std::cerr << "An error occurred while evaluating the circuit: " + e << std::endl;
 				return 1;
@@ -46,7 +151,7 @@ int main(int argc, char **argv) {
 		case 'A':
 		case 'a':
 			try {
-				analysis::run(module);
+				analysis::run(module, options.threads);
 			} catch (std::string &e) {
 				std::cerr << "An error occurred while analyzing the circuit: " + e << std::endl;
 				return 1;
@@ -0,0 +1,224 @@
+#include "native.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace native;
+
+// Instructions per generated function: compilers are superlinear in the size of a function
+static constexpr size_t INSTRUCTIONS_PER_FUNCTION = 256;
+
+namespace {
+	// Names the local variables holding the two rails of each slot, loading them from the buffer
+	// the first time they are read in a function.
+	class Locals {
+		std::stringstream &body;
+		std::vector<uint32_t> defined_in; // The function each local belongs to, plus one
+
+	  public:
+		size_t function = 0;
+
+		Locals(std::stringstream &body, size_t slot_count) : body(body), defined_in(slot_count) {}
+
+		std::string one(uint32_t slot) { return "s" + std::to_string(slot) + "_1"; }
+		std::string zero(uint32_t slot) { return "s" + std::to_string(slot) + "_0"; }
+
+		void read(uint32_t slot) {
+			if (defined_in[slot] == function + 1)
+				return;
+			body << "\tuint64_t " << one(slot) << " = values[" << 2 * slot << "], " << zero(slot)
+			     << " = values[" << 2 * slot + 1 << "];\n";
+			defined_in[slot] = function + 1;
+		}
+
+		void define(uint32_t slot, const std::string &one, const std::string &zero) {
+			body << "\tuint64_t " << this->one(slot) << " = " << one << ", " << this->zero(slot)
+			     << " = " << zero << ";\n";
+			defined_in[slot] = function + 1;
+		}
+
+		void store(uint32_t to, uint32_t from) {
+			body << "\tvalues[" << 2 * to << "] = " << one(from) << ", values[" << 2 * to + 1
+			     << "] = " << zero(from) << ";\n";
+		}
+	};
+} // namespace
+
+/* The formulas are the same as bitparallel::PackedTruthValue. The code is split into functions of
+ * INSTRUCTIONS_PER_FUNCTION instructions, which pass values to each other through the buffer; the
+ * rest stays in registers.
+ */
+std::string native::generate(const bytecode::Program &program) {
+	const std::vector<bytecode::Instruction> &code = program.code;
+	auto function_of = [](size_t instruction) { return instruction / INSTRUCTIONS_PER_FUNCTION; };
+
+	// Slots that must be stored: outputs, flip-flop inputs, and those read by a later function
+	std::vector<bool> observable(program.slot_count);
+	std::vector<size_t> writer(program.slot_count);
+	for (size_t i = 0; i < code.size(); i++) {
+		writer[code[i].dst] = i;
+		for (uint32_t operand : {code[i].lhs, code[i].rhs})
+			if (function_of(writer[operand]) != function_of(i))
+				observable[operand] = true;
+	}
+	for (size_t i = 0; i < program.output_size; i++)
+		observable[program.slot_of(ast::Output{i})] = true;
+	for (const bytecode::Latch &latch : program.latches)
+		observable[latch.from] = true;
+
+	std::stringstream body;
+	Locals locals(body, program.slot_count);
+	for (size_t i = 0; i < code.size(); i++) {
+		if (i % INSTRUCTIONS_PER_FUNCTION == 0) {
+			locals.function = function_of(i);
+			body << "static void part" << locals.function << "(uint64_t *values) {\n";
+		}
+
+		const bytecode::Instruction &instruction = code[i];
+		locals.read(instruction.lhs);
+		locals.read(instruction.rhs);
+		std::string a1 = locals.one(instruction.lhs), a0 = locals.zero(instruction.lhs);
+		std::string b1 = locals.one(instruction.rhs), b0 = locals.zero(instruction.rhs);
+		std::string and1 = a1 + " & " + b1, and0 = a0 + " | " + b0;
+		std::string or1 = a1 + " | " + b1, or0 = a0 + " & " + b0;
+		std::string xor1 = "(" + a1 + " & " + b0 + ") | (" + a0 + " & " + b1 + ")";
+		std::string xor0 = "(" + a1 + " & " + b1 + ") | (" + a0 + " & " + b0 + ")";
+		switch (instruction.opcode) {
+			case bytecode::Opcode::NOT:
+				locals.define(instruction.dst, a0, a1);
+				break;
+			case bytecode::Opcode::AND:
+				locals.define(instruction.dst, and1, and0);
+				break;
+			case bytecode::Opcode::OR:
+				locals.define(instruction.dst, or1, or0);
+				break;
+			case bytecode::Opcode::XOR:
+				locals.define(instruction.dst, xor1, xor0);
+				break;
+			case bytecode::Opcode::NAND:
+				locals.define(instruction.dst, and0, and1);
+				break;
+			case bytecode::Opcode::NOR:
+				locals.define(instruction.dst, or0, or1);
+				break;
+			case bytecode::Opcode::XNOR:
+				locals.define(instruction.dst, xor0, xor1);
+				break;
+			case bytecode::Opcode::COPY:
+				locals.define(instruction.dst, a1, a0);
+				break;
+		}
+		if (observable[instruction.dst])
+			locals.store(instruction.dst, instruction.dst);
+
+		if (i % INSTRUCTIONS_PER_FUNCTION == INSTRUCTIONS_PER_FUNCTION - 1 || i + 1 == code.size())
+			body << "}\n";
+	}
+
+	body << "extern \"C\" void circuit_evaluate(uint64_t *values) {\n";
+	for (size_t function = 0; function <= function_of(code.size() - 1) && !code.empty(); function++)
+		body << "\tpart" << function << "(values);\n";
+	// Emulate a clock tick
+	for (const bytecode::Latch &latch : program.latches)
+		body << "\tvalues[" << 2 * latch.to << "] = values[" << 2 * latch.from << "], values["
+		     << 2 * latch.to + 1 << "] = values[" << 2 * latch.from + 1 << "];\n";
+	body << "}\n";
+
+	return "// Generated by progetto_algoritmi\n#include <stdint.h>\n" + body.str();
+}
+
+// Whether a file belongs to the user and nobody else can write to it, so that nobody else can
+// choose the code that is loaded from it
+static bool is_private(const std::filesystem::path &path, bool directory) {
+	struct stat info;
+	if (lstat(path.c_str(), &info) != 0)
+		return false;
+	bool type = directory ? S_ISDIR(info.st_mode) : S_ISREG(info.st_mode);
+	return type && info.st_uid == geteuid() && (info.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+static std::string read_file(const std::filesystem::path &path) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+// A directory of the temporary directory that only the user can write to
+static std::filesystem::path cache_directory() {
+	std::filesystem::path directory = std::filesystem::temp_directory_path() /
+	                                  ("progetto_algoritmi-" + std::to_string(geteuid()));
+	if (mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+		throw "Failed to create " + directory.string();
+	if (!is_private(directory, true))
+		throw directory.string() + " is not private, so it can't hold compiled circuits";
+	return directory;
+}
+
+Library::Library(const bytecode::Program &program) {
+	namespace fs = std::filesystem;
+	std::string source = generate(program);
+	std::stringstream name;
+	name << std::hex << std::hash<std::string>{}(source);
+	fs::path directory = cache_directory();
+	fs::path library_path = directory / (name.str() + ".so");
+	fs::path source_path = directory / (name.str() + ".cpp");
+
+	// The hash only names the files: a library is reused if its source matches in full
+	if (!is_private(library_path, false) || !is_private(source_path, false) ||
+	    read_file(source_path) != source) {
+		// Build under a unique name and rename it, so that concurrent runs don't see partially
+		// written libraries
+		std::string unique_name = name.str() + "-" + std::to_string(getpid());
+		fs::path temporary_source = directory / (unique_name + ".cpp");
+		fs::path temporary_library = directory / (unique_name + ".so");
+		std::ofstream file(temporary_source);
+		file << source;
+		file.close();
+		if (!file) {
+			// A full disk would otherwise give a truncated source and a confusing compiler error
+			fs::remove(temporary_source);
+			throw "Failed to write " + temporary_source.string();
+		}
+
+		const char *compiler = std::getenv("CXX");
+		std::string command = std::string(compiler ? compiler : "c++") +
+		                      " -O1 -shared -fPIC -o \"" + temporary_library.string() + "\" \"" +
+		                      temporary_source.string() + "\"";
+		int status = std::system(command.c_str());
+		if (status != 0) {
+			fs::remove(temporary_source);
+			throw "Failed to compile the circuit (" + command + ")";
+		}
+		// Regardless of the umask
+		fs::permissions(temporary_library, fs::perms::owner_all);
+		fs::permissions(temporary_source, fs::perms::owner_read | fs::perms::owner_write);
+		fs::rename(temporary_library, library_path);
+		fs::rename(temporary_source, source_path);
+	}
+
+	handle = dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle == nullptr)
+		throw "Failed to load the compiled circuit: "s + dlerror();
+	evaluate = reinterpret_cast<void (*)(uint64_t *)>(dlsym(handle, "circuit_evaluate"));
+	if (evaluate == nullptr) {
+		dlclose(handle);
+		throw "The compiled circuit has no entry point"s;
+	}
+}
+
+Library::~Library() { dlclose(handle); }
+
+kernels::Kernel Library::kernel() const {
+	auto evaluate = this->evaluate;
+	return {"native", 1, [evaluate](const bytecode::Program &, uint64_t *values) {
+		        evaluate(values);
+	        }};
+}
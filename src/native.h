@@ -0,0 +1,30 @@
+#pragma once
+
+#include "kernels.h"
+
+/* Compiles a bytecode::Program ahead of time into straight-line C++, with one local variable per
+ * slot and bitwise operations on packed words. The system compiler turns it into a shared library,
+ * which is loaded with dlopen. Libraries are cached in a directory of the temporary directory that
+ * only the user can write to, named by the hash of their source, so the compilation is only paid
+ * once per netlist. The source is kept next to each library, to tell hash collisions apart.
+ */
+namespace native {
+	// The source of `circuit_evaluate(uint64_t *values)`, which runs a tick of the program over a
+	// bitparallel::Buffer with one word per rail.
+	std::string generate(const bytecode::Program &);
+
+	class Library {
+		void *handle;
+		void (*evaluate)(uint64_t *values);
+
+	  public:
+		// Throws if the compiler is missing or fails. The compiler is $CXX, or c++ by default.
+		explicit Library(const bytecode::Program &);
+		~Library();
+		Library(const Library &) = delete;
+		Library &operator=(const Library &) = delete;
+
+		// A 64-lane kernel that runs the compiled program. Valid as long as the library is.
+		kernels::Kernel kernel() const;
+	};
+} // namespace native
@@ -1,44 +1,138 @@
 #include "parser.h"
-
-#include <unordered_set>
+#include "stats.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <memory>
 
 using namespace ast;
 
-// Split the line by whitespace
-std::vector<std::string> FileParser::tokenize(const std::string &line) {
-	std::string delimiters = " \t";
-	std::vector<std::string> tokens;
-	// For simplicity, basic comment support is implemented at the tokenizer level.
-	if (line[0] == '/' && line[1] == '/')
-		return {};
-	size_t start = line.find_first_not_of(delimiters);
-
-	while (start != std::string::npos) {
-		// Find next whitespace
-		size_t end = line.find_first_of(delimiters, start);
-		tokens.push_back(line.substr(start, end - start));
-		// Skip all whitespace
-		start = line.find_first_not_of(delimiters, end);
-	}
-	return tokens;
-}
+// Smaller module bodies are not worth splitting into chunks
+static constexpr size_t MIN_PARALLEL_BODY_SIZE = 1 << 20;
+
+static std::string quote(std::string_view token) { return "\"" + std::string(token) + "\""; }
 
-bool FileParser::isValidFFName(const std::string &token) const {
+bool FileParser::isValidFFName(std::string_view token) const {
 	return token.length() > 2 && token.substr(0, 2) == "FF" &&
-	       token.substr(2, token.length()).find_first_not_of("0123456789") == std::string::npos;
+	       token.find_first_not_of("0123456789", 2) == std::string_view::npos;
+}
+
+FileParser::FileParser(std::istream &stream, size_t threads)
+    : state(State::IDLE), isClocked(false) {
+	source.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	parse(source, threads);
+}
+
+FileParser::FileParser(std::string_view source, size_t threads)
+    : state(State::IDLE), isClocked(false) {
+	parse(source, threads);
+}
+
+FileParser::FileParser(const FileParser *header)
+    : state(State::MODULE_BODY), isClocked(header->isClocked), header(header) {}
+
+void FileParser::parse(std::string_view source, size_t threads) {
+	STATS_TIME(PARSE);
+	uint64_t linenum = 0;
+	parse_lines(source, linenum, threads != 1);
+	if (!source.empty())
+		parse_body(source, linenum, threads);
 }
 
-FileParser::FileParser(std::istream &stream) : state(State::IDLE), isClocked(false) {
-	std::string line;
-	for (uint64_t linenum = 0; std::getline(stream, line); linenum++) {
-		std::vector<std::string> tokens = tokenize(line);
+// Splits the source into lines and the lines into tokens, separated by whitespace, in place
+void FileParser::parse_lines(std::string_view &source, uint64_t &linenum, bool until_body) {
+	const char *delimiters = " \t";
+	for (; !source.empty(); linenum++) {
+		size_t end = source.find('\n');
+		std::string_view line = source.substr(0, end);
+		source.remove_prefix(end == std::string_view::npos ? source.size() : end + 1);
+
+		// For simplicity, basic comment support is implemented at the tokenizer level.
+		if (line.substr(0, 2) == "//")
+			continue;
 		try {
-			for (const std::string &token : tokens)
-				ingest(token);
+			size_t start = line.find_first_not_of(delimiters);
+			while (start != std::string_view::npos) {
+				// Find next whitespace
+				size_t end = line.find_first_of(delimiters, start);
+				ingest(line.substr(start, end - start));
+				// Skip all whitespace
+				start = line.find_first_not_of(delimiters, end);
+			}
 			ingest_newline();
 		} catch (std::string &e) {
 			throw e + " [line " + std::to_string(linenum) + "]";
 		}
+		if (until_body && state == State::MODULE_BODY) {
+			linenum++;
+			return;
+		}
+	}
+}
+
+/* Assignments only read the symbol tables, except for flip-flops, which are numbered in order of
+ * appearance. Every chunk thus numbers its own flip-flops, and they are renumbered when the chunks
+ * are merged in order, which gives the same result as parsing serially.
+ *
+ * A chunk may not start in the module body, eg. if an assignment spans several lines or there is
+ * something after "endmodule", and errors must be reported with their line number. In these rare
+ * cases the body is simply parsed again serially.
+ */
+void FileParser::parse_body(std::string_view source, uint64_t linenum, size_t threads) {
+	ThreadPool pool(threads);
+	if (pool.size() == 1 || source.size() < MIN_PARALLEL_BODY_SIZE) {
+		parse_lines(source, linenum, false);
+		return;
+	}
+
+	std::vector<std::string_view> chunk_sources;
+	std::string_view rest = source;
+	size_t chunk_size = (source.size() + pool.size() - 1) / pool.size();
+	while (!rest.empty()) {
+		size_t end = rest.size() <= chunk_size ? rest.size() : rest.find('\n', chunk_size);
+		end = end >= rest.size() ? rest.size() : end + 1;
+		chunk_sources.push_back(rest.substr(0, end));
+		rest.remove_prefix(end);
+	}
+
+	std::vector<std::unique_ptr<FileParser>> chunks(chunk_sources.size());
+	std::vector<char> succeeded(chunks.size(), false);
+	pool.parallel_for(chunks.size(), [&](size_t i) {
+		chunks[i].reset(new FileParser(this));
+		try {
+			uint64_t local_linenum = 0;
+			chunks[i]->parse_lines(chunk_sources[i], local_linenum, false);
+			succeeded[i] = i + 1 == chunks.size() || chunks[i]->state == State::MODULE_BODY;
+		} catch (std::string &) {
+		}
+	});
+
+	if (std::find(succeeded.begin(), succeeded.end(), false) != succeeded.end()) {
+		parse_lines(source, linenum, false);
+		return;
+	}
+	std::vector<std::vector<Flipflop>> renumbered(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+		for (uint16_t id : chunks[i]->flipflops)
+			renumbered[i].push_back(find_or_create_ff_id(id));
+	pool.parallel_for(chunks.size(), [&](size_t i) { chunks[i]->renumber(renumbered[i]); });
+
+	for (std::unique_ptr<FileParser> &chunk : chunks)
+		for (std::vector<Assignment> &run : chunk->assignments)
+			assignments.push_back(std::move(run));
+	state = chunks.back()->state;
+}
+
+void FileParser::renumber(const std::vector<Flipflop> &renumbered) {
+	for (std::vector<Assignment> &run : assignments) {
+		for (Assignment &assignment : run) {
+			if (is_ff(assignment.lvalue))
+				assignment.lvalue = renumbered[get_ff(assignment.lvalue).offset];
+			for (Token &token : assignment.expression)
+				if (is_ff(token))
+					token = renumbered[get_ff(token).offset];
+		}
 	}
 }
 
@@ -47,7 +141,7 @@ Module FileParser::finalize() {
 	if (state != State::IDLE)
 		throw "Parsing ended prematurely"s;
 	std::vector<Assignment> sorted_assignments = toposort_assignments();
-	return Module(isClocked, inputs, flipflops, outputs, sorted_assignments);
+	return Module(isClocked, inputs, flipflops, outputs, std::move(sorted_assignments));
 }
 
 /* This method sorts assignments topologically using Kahn's algorithm. Note that children represent
@@ -61,87 +155,123 @@ Module FileParser::finalize() {
  * The output node is an orphan node and is added to the initial set, but must not be added to the
  * list of sorted nodes; rather, we must add it when all of the flip-flop inputs have been visited,
  * which is when the input node becomes an orphan.
- * FF.
+ *
+ * Every node has a list of its parents and every assignment counts its distinct children, so each
+ * edge is visited once and the sort takes O(V + E).
  */
-std::vector<Assignment> FileParser::toposort_assignments() const {
-	using namespace ast;
-
-	using Node = std::variant<Input, Output, Flipflop>;
-	using LogicCone = std::unordered_set<Node>;
-
-	// Calculate logic cones in advance to cut down on lookup costs in Kahn's algorithm
-	std::unordered_map<LValue, LogicCone> logic_cones;
-	for (const std::pair<const LValue, Expression> &assignment : assignments) {
-		LogicCone logic_cone;
-		for (const Token &token : assignment.second) {
-			if (is_input(token))
-				logic_cone.emplace(get_input(token));
-			else if (is_ff(token))
-				logic_cone.emplace(get_ff(token));
-			else if (is_output(token))
-				logic_cone.emplace(get_output(token));
+std::vector<Assignment> FileParser::toposort_assignments() {
+	STATS_TIME(TOPOSORT);
+	// Nodes are numbered with the inputs first, then the flip-flops, then the outputs
+	size_t ff_base = inputs.size(), output_base = ff_base + flipflops.size();
+	size_t node_count = output_base + outputs.size();
+	auto node_of = [&](const Token &token) -> std::optional<uint32_t> {
+		if (is_input(token))
+			return get_input(token).offset;
+		if (is_ff(token))
+			return ff_base + get_ff(token).offset;
+		if (is_output(token))
+			return output_base + get_output(token).offset;
+		return std::nullopt;
+	};
+	auto lvalue_node_of = [&](const LValue &lvalue) -> uint32_t {
+		return is_output(lvalue) ? output_base + get_output(lvalue).offset
+		                         : ff_base + get_ff(lvalue).offset;
+	};
+
+	// The parents of node i are parents[parent_offsets[i], parent_offsets[i + 1]), as indices into
+	// `lvalues`. An operand that appears several times in an expression is a single edge.
+	std::vector<Assignment *> lvalues;
+	{
+		// Only the last assignment to every lvalue counts
+		std::vector<Assignment *> last(node_count, nullptr);
+		for (std::vector<Assignment> &run : assignments)
+			for (Assignment &assignment : run)
+				last[lvalue_node_of(assignment.lvalue)] = &assignment;
+		for (std::vector<Assignment> &run : assignments)
+			for (Assignment &assignment : run)
+				if (last[lvalue_node_of(assignment.lvalue)] == &assignment)
+					lvalues.push_back(&assignment);
+	}
+
+	std::vector<uint32_t> children(lvalues.size(), 0);
+	std::vector<std::pair<uint32_t, uint32_t>> edges; // (child, parent)
+	std::vector<uint32_t> last_parent(node_count, UINT32_MAX);
+	for (uint32_t parent = 0; parent < lvalues.size(); parent++) {
+		for (const Token &token : lvalues[parent]->expression) {
+			std::optional<uint32_t> child = node_of(token);
+			if (child && last_parent[*child] != parent) {
+				last_parent[*child] = parent;
+				edges.emplace_back(*child, parent);
+				children[parent]++;
+			}
 		}
-		logic_cones[assignment.first] = logic_cone;
+	}
+	std::vector<uint32_t> parent_offsets(node_count + 1, 0);
+	for (const auto &edge : edges)
+		parent_offsets[edge.first + 1]++;
+	for (size_t i = 0; i < node_count; i++)
+		parent_offsets[i + 1] += parent_offsets[i];
+	std::vector<uint32_t> parents(edges.size());
+	{
+		std::vector<uint32_t> next(parent_offsets.begin(), parent_offsets.end() - 1);
+		for (const auto &edge : edges)
+			parents[next[edge.first]++] = edge.second;
 	}
 
 	std::vector<Assignment> sorted_assignments;
-	std::stack<Node> childless_nodes;
+	sorted_assignments.reserve(lvalues.size());
+	std::stack<uint32_t> childless_nodes;
 	for (size_t i = 0; i < inputs.size(); i++)
-		childless_nodes.push(Input{i});
+		childless_nodes.push(i);
 	for (size_t i = 0; i < flipflops.size(); i++)
-		childless_nodes.push(Flipflop{i});
+		childless_nodes.push(ff_base + i);
 
 	while (!childless_nodes.empty()) {
-		Node node = pop(childless_nodes);
-
-		// Find parents of `node`, i.e. expressions that depend on it
-		for (std::pair<const LValue, LogicCone> &kv_pair : logic_cones) {
-			const LValue &lvalue = kv_pair.first;
-			LogicCone &logic_cone = kv_pair.second;
-			auto pos = logic_cone.find(node);
-			// If `lvalue` is indeed a parent...
-			if (pos != logic_cone.end()) {
-				// Remove the edge `lvalue->node`
-				logic_cone.erase(pos);
-				// If `lvalue` has become childless, push it to `childless_nodes`
-				if (logic_cone.empty()) {
-					// Note that we don't push FFs to `childless_nodes`: we already did that at the
-					// beginning, and doing so again will create a loop.
-					if (is_output(lvalue))
-						childless_nodes.push(get_output(lvalue));
-
-					// In Kahn's algorithm, this would be the step where we add `node` to the list
-					// of sorted nodes. We push directly onto `sorted_assignments` instead.
-					sorted_assignments.emplace_back(lvalue, assignments.at(lvalue));
-				}
+		uint32_t node = pop(childless_nodes);
+
+		// Remove the edges from the parents of `node`, i.e. expressions that depend on it
+		for (uint32_t i = parent_offsets[node]; i < parent_offsets[node + 1]; i++) {
+			uint32_t parent = parents[i];
+			// If the parent has become childless, push it to `childless_nodes`
+			if (--children[parent] == 0) {
+				const LValue &lvalue = lvalues[parent]->lvalue;
+				// Note that we don't push FFs to `childless_nodes`: we already did that at the
+				// beginning, and doing so again will create a loop.
+				if (is_output(lvalue))
+					childless_nodes.push(output_base + get_output(lvalue).offset);
+
+				// In Kahn's algorithm, this would be the step where we add `node` to the list
+				// of sorted nodes. We push directly onto `sorted_assignments` instead.
+				sorted_assignments.emplace_back(lvalue, std::move(lvalues[parent]->expression));
 			}
 		}
 	}
 
-	for (std::pair<const ast::LValue, LogicCone> &kv_pair : logic_cones) {
-		if (!kv_pair.second.empty())
+	for (uint32_t count : children) {
+		if (count != 0)
 			throw "The circuit contains feedback loops"s;
 	}
 
 	return sorted_assignments;
 }
 
-void FileParser::ingest(const std::string &token) {
+void FileParser::ingest(std::string_view token) {
 	switch (state) {
 		case State::IDLE:
-			if (token == "module")
+			// Chunks of a module body can't declare another module
+			if (token == "module" && header == nullptr)
 				state = State::MODULE_DECLARATION;
 			else
-				throw "Unexpected token: \"" + token + "\"";
+				throw "Unexpected token: " + quote(token);
 			break;
 		case State::MODULE_DECLARATION:
 			// The module name is unused in the assignment.
 			state = State::PARAMETER_DECLARATION;
 			break;
 		case State::PARAMETER_DECLARATION: {
-			std::string clean_token = token;
+			std::string_view clean_token = token;
 			if (token.front() == '(')
-				clean_token.erase(0, 1);
+				clean_token.remove_prefix(1);
 
 			if (clean_token.empty())
 				; // We ingested a simple open parenthesis, let's do nothing
@@ -154,35 +284,27 @@ void FileParser::ingest(const std::string &token) {
 			else if (clean_token == ");")
 				state = State::MODULE_BODY;
 			else
-				throw "Unexpected token: \"" + clean_token + "\"";
+				throw "Unexpected token: " + quote(clean_token);
 			break;
 		}
 		case State::INPUT_PARAMETERS: {
-			std::string clean_token = token;
+			std::string_view clean_token = token;
 			if (token.back() == ',')
-				clean_token.pop_back();
-
-			bool input_exists = input_find(clean_token).has_value();
-			bool output_exists = output_find(clean_token).has_value();
-			if (input_exists || output_exists)
-				throw "Input parameter \"" + clean_token + "\" was already declared";
+				clean_token.remove_suffix(1);
 
-			input_map[clean_token] = ast::Input{inputs.size()};
-			inputs.push_back(clean_token);
+			if (!symbols.insert(clean_token, ast::Input{inputs.size()}))
+				throw "Input parameter " + quote(clean_token) + " was already declared";
+			inputs.emplace_back(clean_token);
 			break;
 		}
 		case State::OUTPUT_PARAMETERS: {
-			std::string clean_token = token;
+			std::string_view clean_token = token;
 			if (token.back() == ',')
-				clean_token.pop_back();
-
-			bool input_exists = input_find(clean_token).has_value();
-			bool output_exists = output_find(clean_token).has_value();
-			if (input_exists || output_exists)
-				throw "Output parameter \"" + clean_token + "\" was already declared";
+				clean_token.remove_suffix(1);
 
-			output_map[clean_token] = ast::Output{outputs.size()};
-			outputs.push_back(clean_token);
+			if (!symbols.insert(clean_token, ast::Output{outputs.size()}))
+				throw "Output parameter " + quote(clean_token) + " was already declared";
+			outputs.emplace_back(clean_token);
 			break;
 		}
 		case State::MODULE_BODY:
@@ -193,29 +315,28 @@ void FileParser::ingest(const std::string &token) {
 			else if (isValidFFName(token)) {
 				if (!isClocked)
 					throw "Flip-flop found in asynchronous circuit"s;
-				uint16_t id = std::stoi(token.substr(2, token.length()));
-				temporaryFFAssignment.lvalue = find_or_create_ff_id(id);
-				temporaryFFAssignment.parser = ExpressionParser();
+				temporaryFFAssignment.lvalue = find_or_create_ff(token);
 				state = State::FF_ASSIGNMENT_EQUALS;
 			} else
-				throw "Unexpected token: \"" + token + "\"";
+				throw "Unexpected token: " + quote(token);
 			break;
-		case State::ASSIGNMENT_START:
-			if (!output_find(token).has_value())
-				throw "No such output: " + token;
-			temporaryAssignment.lvalue = ast::Output{output_map[token]};
-			temporaryAssignment.parser = ExpressionParser();
+		case State::ASSIGNMENT_START: {
+			std::optional<Output> output = output_find(token);
+			if (!output.has_value())
+				throw "No such output: " + std::string(token);
+			temporaryAssignment.lvalue = output.value();
 			state = State::ASSIGNMENT_EQUALS;
 			break;
+		}
 		case State::ASSIGNMENT_EQUALS:
 			if (token == "=")
 				state = State::ASSIGNMENT_BODY;
 			else
-				throw "Unexpected token: \"" + token + "\"";
+				throw "Unexpected token: " + quote(token);
 			break;
 		case State::ASSIGNMENT_BODY:
 			try {
-				temporaryAssignment.parser.ingest(token);
+				ingest_expression(temporaryAssignment.parser, token);
 			} catch (std::string &e) {
 				throw "An error occurred while parsing the expression: " + e;
 			}
@@ -224,11 +345,11 @@ void FileParser::ingest(const std::string &token) {
 			if (token == "=")
 				state = State::FF_ASSIGNMENT_BODY;
 			else
-				throw "Unexpected token: \"" + token + "\"";
+				throw "Unexpected token: " + quote(token);
 			break;
 		case State::FF_ASSIGNMENT_BODY:
 			try {
-				temporaryFFAssignment.parser.ingest(token);
+				ingest_expression(temporaryFFAssignment.parser, token);
 			} catch (std::string &e) {
 				throw "An error occurred while parsing the expression: " + e;
 			}
@@ -244,9 +365,8 @@ void FileParser::ingest_newline() {
 			break;
 		case State::ASSIGNMENT_BODY: {
 			try {
-				std::deque<std::string> assignment = temporaryAssignment.parser.finalize();
-				Expression expression = compile(assignment);
-				assignments[temporaryAssignment.lvalue] = expression;
+				assignments.back().emplace_back(temporaryAssignment.lvalue,
+				                                temporaryAssignment.parser.finalize());
 			} catch (std::string &e) {
 				throw "An error occurred while parsing the expression: " + e;
 			}
@@ -255,56 +375,58 @@ void FileParser::ingest_newline() {
 		}
 		case State::FF_ASSIGNMENT_BODY: {
 			try {
-				std::deque<std::string> assignment = temporaryFFAssignment.parser.finalize();
-				Expression expression = compile(assignment);
-				assignments[temporaryFFAssignment.lvalue] = expression;
+				assignments.back().emplace_back(temporaryFFAssignment.lvalue,
+				                                temporaryFFAssignment.parser.finalize());
 			} catch (std::string &e) {
 				throw "An error occurred while parsing the expression: " + e;
 			}
 			state = State::MODULE_BODY;
 			break;
 		}
+		default:
+			break;
 	}
 }
 
-// Compiles an assignment made of tokens into a proper ast::Expression
-Expression FileParser::compile(const std::deque<std::string> &assignment) {
-	Expression ret;
-	for (const std::string &token : assignment) {
-		std::optional<Operator> op = try_resolve_operator(token);
-		if (op.has_value())
-			ret.push_back(op.value());
-		else if (isValidFFName(token)) {
-			uint16_t id = std::stoi(token.substr(2, token.length()));
-			ret.push_back(find_or_create_ff_id(id));
-		} else {
-			std::optional<Input> input = input_find(token);
-			std::optional<Output> output = output_find(token);
-			if (input.has_value())
-				ret.push_back(input.value());
-			else if (output.has_value())
-				ret.push_back(output.value());
-			else
-				throw "No such variable: " + token;
-		}
+// Feeds a token of an expression to the parser, splitting off the parentheses that are lumped
+// together with it and resolving operators and variables
+void FileParser::ingest_expression(ExpressionParser &parser, std::string_view token) {
+	if (token.length() > 1 && token.front() == '(') {
+		parser.open_parenthesis();
+		ingest_expression(parser, token.substr(1));
+	} else if (token.length() > 1 && token.back() == ')') {
+		ingest_expression(parser, token.substr(0, token.length() - 1));
+		parser.close_parenthesis();
+	} else if (token == "(") {
+		parser.open_parenthesis();
+	} else if (token == ")") {
+		parser.close_parenthesis();
+	} else if (std::optional<Operator> op = try_resolve_operator(token)) {
+		parser.push_operator(op.value());
+	} else if (isValidFFName(token)) {
+		parser.push_operand(find_or_create_ff(token));
+	} else {
+		const Token *symbol = symbol_table().find(token);
+		if (symbol == nullptr)
+			throw "No such variable: " + std::string(token);
+		parser.push_operand(*symbol);
 	}
-	return ret;
 }
 
-std::optional<Input> FileParser::input_find(const std::string &input) const {
-	auto it = input_map.find(input);
-	if (it == input_map.end())
+std::optional<Input> FileParser::input_find(std::string_view name) const {
+	const Token *symbol = symbol_table().find(name);
+	if (symbol == nullptr || !is_input(*symbol))
 		return {};
 	else
-		return it->second;
+		return get_input(*symbol);
 }
 
-std::optional<Output> FileParser::output_find(const std::string &input) const {
-	auto it = output_map.find(input);
-	if (it == output_map.end())
+std::optional<Output> FileParser::output_find(std::string_view name) const {
+	const Token *symbol = symbol_table().find(name);
+	if (symbol == nullptr || !is_output(*symbol))
 		return {};
 	else
-		return it->second;
+		return get_output(*symbol);
 }
 
 Flipflop FileParser::find_or_create_ff_id(uint16_t id) {
@@ -319,47 +441,75 @@ Flipflop FileParser::find_or_create_ff_id(uint16_t id) {
 	}
 }
 
+// Requires a valid flip-flop name
+Flipflop FileParser::find_or_create_ff(std::string_view name) {
+	unsigned long id;
+	auto result = std::from_chars(name.data() + 2, name.data() + name.size(), id);
+	if (result.ec != std::errc())
+		throw "Invalid flip-flop: " + std::string(name);
+	return find_or_create_ff_id(uint16_t(id));
+}
+
 // Implements Dijkstra's shunting yard algorithm
-void ExpressionParser::ingest(const std::string &token) {
-	// Special cases for tokens that lump together a parenthesis
-	if (token.length() > 1 && token.substr(0, 1) == "(") {
-		ingest("(");
-		ingest(token.substr(1, token.length() - 1));
-	} else if (token.length() > 1 && token.back() == ')') {
-		ingest(token.substr(0, token.length() - 1));
-		ingest(")");
-	} else if (token == "(") {
-		operatorStack.push(token);
-	} else if (token == ")") {
-		while (!operatorStack.empty() && operatorStack.top() != "(") {
-			output.push_front(operatorStack.top());
-			operatorStack.pop();
-		}
-		if (operatorStack.empty())
-			throw "Mismatched parentheses"s;
-		// The top must contain a "(" by now.
-		operatorStack.pop();
-	} else {
-		std::optional<Operator> op = try_resolve_operator(token);
-		if (op.has_value()) {
-			if (arity(op.value()) == 2)
-				while (!operatorStack.empty() && operatorStack.top() != "(") {
-					output.push_front(operatorStack.top());
-					operatorStack.pop();
-				}
-			operatorStack.push(token);
-		} else {
-			output.push_front(token);
-		}
-	}
+void ExpressionParser::open_parenthesis() { operatorStack.push(std::nullopt); }
+
+void ExpressionParser::close_parenthesis() {
+	while (!operatorStack.empty() && operatorStack.top().has_value())
+		output.push_back(pop(operatorStack).value());
+	if (operatorStack.empty())
+		throw "Mismatched parentheses"s;
+	// The top must contain a "(" by now.
+	operatorStack.pop();
 }
 
-std::deque<std::string> ExpressionParser::finalize() {
+void ExpressionParser::push_operator(Operator op) {
+	if (arity(op) == 2)
+		while (!operatorStack.empty() && operatorStack.top().has_value())
+			output.push_back(pop(operatorStack).value());
+	operatorStack.push(op);
+}
+
+void ExpressionParser::push_operand(Token token) { output.push_back(token); }
+
+Expression ExpressionParser::finalize() {
 	while (!operatorStack.empty()) {
-		if (operatorStack.top() == "(")
+		if (!operatorStack.top().has_value())
 			throw "Mismatched parentheses"s;
-		output.push_front(operatorStack.top());
-		operatorStack.pop();
+		output.push_back(pop(operatorStack).value());
 	}
-	return output;
+	Expression expression(output.rbegin(), output.rend());
+	output.clear();
+	return expression;
+}
+
+size_t SymbolTable::find_entry(std::string_view name, size_t hash) const {
+	size_t mask = entries.size() - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		const Entry &entry = entries[i];
+		if (entry.name.empty() || (entry.hash == hash && entry.name == name))
+			return i;
+	}
+}
+
+bool SymbolTable::insert(std::string_view name, Token token) {
+	size_t hash = std::hash<std::string_view>{}(name);
+	size_t i = find_entry(name, hash);
+	if (!entries[i].name.empty())
+		return false;
+	entries[i] = {hash, name, token};
+
+	// Keep the table at most half full, so that probe sequences stay short
+	if (++count * 2 > entries.size()) {
+		std::vector<Entry> old = std::move(entries);
+		entries = std::vector<Entry>(old.size() * 2);
+		for (const Entry &entry : old)
+			if (!entry.name.empty())
+				entries[find_entry(entry.name, entry.hash)] = entry;
+	}
+	return true;
+}
+
+const Token *SymbolTable::find(std::string_view name) const {
+	const Entry &entry = entries[find_entry(name, std::hash<std::string_view>{}(name))];
+	return entry.name.empty() ? nullptr : &entry.token;
 }
@@ -2,16 +2,44 @@
 
 #include "ast.h"
 #include <istream>
+#include <string_view>
 #include <unordered_map>
 
+// Converts an infix expression to prefix notation. Operands are resolved by the caller.
 class ExpressionParser {
-	std::deque<std::string> output;
-	std::stack<std::string> operatorStack;
+	// In postfix order, reversed by finalize()
+	std::vector<ast::Token> output;
+	// std::nullopt stands for an open parenthesis
+	using StackItem = std::optional<ast::Operator>;
+	std::stack<StackItem, std::vector<StackItem>> operatorStack;
 
   public:
 	ExpressionParser() = default;
-	void ingest(const std::string &token);
-	std::deque<std::string> finalize();
+	void open_parenthesis();
+	void close_parenthesis();
+	void push_operator(ast::Operator);
+	void push_operand(ast::Token);
+	// Returns the expression and resets the parser, keeping its memory for the next one
+	ast::Expression finalize();
+};
+
+// Maps names to tokens with open addressing, so that lookups usually touch a single cache line.
+// The names are not copied.
+class SymbolTable {
+	struct Entry {
+		size_t hash;
+		std::string_view name; // Empty for unused entries
+		ast::Token token;
+	};
+	std::vector<Entry> entries = std::vector<Entry>(64);
+	size_t count = 0;
+
+	size_t find_entry(std::string_view name, size_t hash) const;
+
+  public:
+	// Returns false if the name is already defined
+	bool insert(std::string_view name, ast::Token);
+	const ast::Token *find(std::string_view name) const;
 };
 
 class FileParser {
@@ -35,13 +63,19 @@ class FileParser {
 	std::vector<std::string> outputs;
 	std::vector<uint16_t> flipflops;
 
-	// Auxiliary data structures for O(1) resolution of variable names
-	std::unordered_map<std::string, ast::Input> input_map;
-	std::unordered_map<std::string, ast::Output> output_map;
+	// Auxiliary data structures for O(1) resolution of variable names. Inputs and outputs are
+	// interned when they are declared, and the names point into the source.
+	SymbolTable symbols;
 	std::unordered_map<uint16_t, ast::Flipflop> ff_map;
 
-	// We don't care about order at this stage (pre-toposort)
-	std::unordered_map<ast::LValue, ast::Expression> assignments;
+	// In the order of the file, which we don't care about at this stage (pre-toposort). A later
+	// assignment to the same lvalue replaces the earlier ones. They are stored in runs, so that the
+	// chunks of a module body can be appended without moving every assignment.
+	std::vector<std::vector<ast::Assignment>> assignments{1};
+
+	// Set on the parsers of the chunks of a module body, which share the symbols of the parser of
+	// the module header. Their flip-flops are numbered locally until they are merged.
+	const FileParser *header = nullptr;
 
 	struct {
 		ast::Output lvalue;
@@ -52,21 +86,41 @@ class FileParser {
 		ExpressionParser parser;
 	} temporaryFFAssignment;
 
-	void ingest(const std::string &token);
+	// Only used when parsing a stream
+	std::string source;
+
+	explicit FileParser(const FileParser *header);
+
+	void parse(std::string_view source, size_t threads);
+	// Parses the lines at the front of `source`; if `until_body` is set, stops after the line
+	// where the module body begins
+	void parse_lines(std::string_view &source, uint64_t &linenum, bool until_body);
+	// Parses chunks of the module body concurrently, then merges them in order
+	void parse_body(std::string_view source, uint64_t linenum, size_t threads);
+	// Replaces the flip-flops of a chunk, numbered locally, with `renumbered[offset]`
+	void renumber(const std::vector<ast::Flipflop> &renumbered);
+	void ingest(std::string_view token);
 	void ingest_newline();
+	void ingest_expression(ExpressionParser &, std::string_view token);
+
+	const SymbolTable &symbol_table() const { return header ? header->symbols : symbols; }
 
 	// Helpers
-	std::optional<ast::Input> input_find(const std::string &) const;
-	std::optional<ast::Output> output_find(const std::string &) const;
+	std::optional<ast::Input> input_find(std::string_view) const;
+	std::optional<ast::Output> output_find(std::string_view) const;
 	ast::Flipflop find_or_create_ff_id(uint16_t id);
+	ast::Flipflop find_or_create_ff(std::string_view name);
 
-	bool isValidFFName(const std::string &) const;
+	bool isValidFFName(std::string_view) const;
 
-	static std::vector<std::string> tokenize(const std::string &line);
-	ast::Expression compile(const std::deque<std::string> &assignment);
-	std::vector<ast::Assignment> toposort_assignments() const;
+	// Moves the expressions out of `assignments`
+	std::vector<ast::Assignment> toposort_assignments();
 
   public:
-	FileParser(std::istream &);
+	// The module body of large netlists is parsed on `threads` threads (0: one per core)
+	explicit FileParser(std::istream &, size_t threads = 1);
+	// Parses a netlist in memory, such as a vectorio::MappedFile. The source must outlive the
+	// parser.
+	explicit FileParser(std::string_view source, size_t threads = 1);
 	ast::Module finalize();
 };
@@ -1,18 +1,299 @@
 #!/bin/bash
-function check() {
-    if [[ $(echo "$1" | ./progetto_algoritmi $2 | md5sum | head -c 32) = $3 ]]
+# Runs from a directory with input/ and the progetto_algoritmi and convert_vectors executables
+
+function expect() {
+    if [[ $2 = "$3" ]]
     then
-        echo "pass: $2"
+        echo "pass: $1"
         return 0
     else
-        echo "FAIL: $2"
+        echo "FAIL: $1"
         return 1
     fi
 }
 
+function check() {
+    expect "$2" $(echo "$1" | ./progetto_algoritmi $2 | md5sum | head -c 32) $3
+}
+
+# Like check, but hashes the file $3 that the simulator writes instead of its output
+function check_file() {
+    echo "$1" | ./progetto_algoritmi $2 > /dev/null
+    expect "$2" $(md5sum < "$3" | head -c 32) $4
+}
+
+# The outputs of a simulation, without the prompts before the first one
+function outputs() {
+    sed 's/^.*: //'
+}
+
+function hash() {
+    md5sum | head -c 32
+}
+
+# Prints the file $2 $1 times
+function repeat() {
+    for i in $(seq $1)
+    do
+        cat "$2"
+    done
+}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
 # Check the output against hashes of outputs that were verified by hand to be correct
 check a input/analysis_edge_cases.v b3f6dcaad3e614ae7e18b99f57b4eca1
 check s input/logic_properties.v b00719eaf7da5da8b39af5de253aa9f6
 check s input/single_gates.v b6896f9decb5242680eea8aae71276ed
 check a input/toposort.v 9e53656763b7576f82716eec337a1679
 check s input/toposort.v 957aca9b836113040b5857388209aedd
+
+# input/vectors.txt has every combination of the inputs. Repeated, it takes more than the 64 lanes
+# of a word, and must give the same outputs again.
+(cat input/vectors.txt; echo) > "$tmp/vectors.txt"
+echo s | ./progetto_algoritmi input/single_gates.v | outputs > "$tmp/single_gates.txt"
+repeat 5 "$tmp/vectors.txt" > "$tmp/80.txt"
+echo -e "s\n$tmp/80.txt" | ./progetto_algoritmi input/single_gates.v | outputs > "$tmp/80.out"
+expect "80 vectors" $(hash < "$tmp/80.out") $(repeat 5 "$tmp/single_gates.txt" | hash)
+# NOT, AND, OR, XOR, NAND, NOR and XNOR of a = 1 and b = 1, in lane 13 of the second word
+expect "80 vectors, line 78 is 0110001" "$(sed -n 78p "$tmp/80.out")" 0110001
+
+# Past the 512 lanes of the widest kernel
+repeat 40 "$tmp/vectors.txt" > "$tmp/640.txt"
+echo -e "s\n$tmp/640.txt" | ./progetto_algoritmi input/single_gates.v | outputs > "$tmp/640.out"
+expect "640 vectors" $(hash < "$tmp/640.out") $(repeat 40 "$tmp/single_gates.txt" | hash)
+# a = 0 and b = 1, in lane 87 of the second 512-bit word
+expect "640 vectors, line 600 is 1011100" "$(sed -n 600p "$tmp/640.out")" 1011100
+
+check s "-j 4 input/single_gates.v" b6896f9decb5242680eea8aae71276ed
+check s "-j 4 input/toposort.v" 957aca9b836113040b5857388209aedd
+# Enough vectors for several chunks on each of the threads, printed in order
+repeat 4500 "$tmp/vectors.txt" > "$tmp/72000.txt"
+echo -e "s\n$tmp/72000.txt" | ./progetto_algoritmi -j 4 input/single_gates.v | outputs \
+    > "$tmp/72000.out"
+expect "72000 vectors on 4 threads" $(hash < "$tmp/72000.out") \
+    $(repeat 4500 "$tmp/single_gates.txt" | hash)
+expect "72000 vectors on 4 threads, 72000 lines" $(wc -l < "$tmp/72000.out") 72000
+
+# A clocked circuit with a level of over 4096 instructions, which runs on several threads: 2048
+# flip-flops that c resets to 0, each mixing two others and an input
+inputs=(a b d)
+{
+    echo "module WIDE ("
+    echo "	clk"
+    echo "	input a, b, c, d"
+    echo "	output y0, y1, y2, y3, y4, y5, y6, y7"
+    echo ");"
+    for i in $(seq 0 7)
+    do
+        echo "	assign y$i = FF$((256 * i + 255))"
+    done
+    for i in $(seq 0 2047)
+    do
+        j=$(((5 * i + 1) % 2048)) k=$(((3 * i + 7) % 2048))
+        echo "	FF$i = NOT c AND ((FF$j OR ${inputs[i % 3]}) XOR FF$k)"
+    done
+    echo "endmodule"
+} > "$tmp/wide.v"
+{
+    echo 0010
+    seed=1
+    for i in $(seq 300)
+    do
+        seed=$(((seed * 1103515245 + 12345) % 2147483648))
+        echo $((seed >> 30 & 1))$((seed >> 29 & 1))0$((seed >> 28 & 1))
+    done
+} > "$tmp/wide.txt"
+echo -e "s\n$tmp/wide.txt" | ./progetto_algoritmi -j 1 "$tmp/wide.v" | outputs > "$tmp/wide.out"
+echo -e "s\n$tmp/wide.txt" | ./progetto_algoritmi -j 4 "$tmp/wide.v" | outputs > "$tmp/wide4.out"
+expect "2048 flip-flops on 4 threads" $(hash < "$tmp/wide4.out") $(hash < "$tmp/wide.out")
+expect "2048 flip-flops, reset" "$(sed -n 2p "$tmp/wide.out")" 00000000
+
+# Every engine gives the same outputs
+for engine in interpreted compiled bitparallel event
+do
+    check s "--engine $engine input/single_gates.v" b6896f9decb5242680eea8aae71276ed
+done
+for engine in interpreted compiled event
+do
+    check s "--engine $engine input/toposort.v" 957aca9b836113040b5857388209aedd
+done
+# The event-driven engine doesn't evaluate the gates whose operands didn't change. It only says so
+# with --verbose.
+skipped=$(echo s | ./progetto_algoritmi --engine event --verbose input/toposort.v 2>&1 > /dev/null |
+    grep -o '[0-9]* skipped' | cut -d ' ' -f 1)
+expect "--engine event skips evaluations ($skipped)" $((skipped > 0)) 1
+expect "--engine event is quiet without --verbose" \
+    "$(echo s | ./progetto_algoritmi --engine event input/toposort.v 2>&1 > /dev/null)" ""
+
+# The generated code, and the bit-parallel engine running circuits with flip-flops in lane 0
+check s "--engine native input/single_gates.v" b6896f9decb5242680eea8aae71276ed
+for engine in bitparallel native
+do
+    check s "--engine $engine input/toposort.v" 957aca9b836113040b5857388209aedd
+done
+# The library is built and loaded instead of falling back to the default engine, and is cached in
+# a directory that only the user can write
+expect "--engine native doesn't fall back" \
+    "$(echo s | ./progetto_algoritmi --engine native input/toposort.v 2>&1 > /dev/null)" ""
+expect "the native cache is private" \
+    $(stat -c %a "${TMPDIR:-/tmp}/progetto_algoritmi-$(id -u)") 700
+
+# Every combination of 0, 1 and X of four inputs, converted to binary and back
+for a in 0 1 x; do for b in 0 1 x; do for c in 0 1 x; do for d in 0 1 x; do
+    echo $a$b$c$d
+done; done; done; done > "$tmp/all.txt"
+./convert_vectors "$tmp/all.txt" "$tmp/all.pav"
+./convert_vectors "$tmp/all.pav" "$tmp/all.out"
+expect "convert_vectors round trip" $(hash < "$tmp/all.out") $(hash < "$tmp/all.txt")
+# "PAV1", 2 bits per value in 32 bits, 4 values per vector in 64 bits, 81 vectors in 64 bits
+expect "binary header" "$(od -An -v -tu1 -N 24 "$tmp/all.pav" | xargs)" \
+    "80 65 86 49 2 0 0 0 4 0 0 0 0 0 0 0 81 0 0 0 0 0 0 0"
+check s "--vectors $tmp/all.txt input/single_gates.v" 235414e100ef7d74ec8e22876142b2d4
+check s "--vectors $tmp/all.pav input/single_gates.v" 235414e100ef7d74ec8e22876142b2d4
+./progetto_algoritmi --mode s --vectors "$tmp/all.pav" --output "$tmp/all.out" \
+    input/single_gates.v
+# NOT, AND, OR, XOR, NAND, NOR and XNOR of a = X and b = 0
+expect "single_gates.v, x000 gives x0xx1xx" "$(sed -n 55p "$tmp/all.out")" x0xx1xx
+./progetto_algoritmi --mode s --vectors "$tmp/all.pav" --output "$tmp/all.bin" \
+    --output-format binary input/single_gates.v
+./convert_vectors "$tmp/all.bin" "$tmp/all.bin.txt"
+expect "binary results" $(hash < "$tmp/all.bin.txt") $(hash < "$tmp/all.out")
+
+check s "--no-optimize input/toposort.v" 957aca9b836113040b5857388209aedd
+check s "--no-optimize input/single_gates.v" b6896f9decb5242680eea8aae71276ed
+for circuit in input/analysis_edge_cases.v input/x_propagation.v
+do
+    options="--mode s --vectors $tmp/all.txt $circuit"
+    expect "--no-optimize, $circuit" $(./progetto_algoritmi --no-optimize $options | hash) \
+        $(./progetto_algoritmi $options | hash)
+done
+# The negations in analysis_edge_cases.v are folded into the gates that they negate
+expect "fold negations, input/analysis_edge_cases.v" \
+    "$(echo s | ./progetto_algoritmi --verbose input/analysis_edge_cases.v 2>&1 > /dev/null |
+        grep 'fold negations')" 'Optimization pass "fold negations": 19 -> 15 instructions'
+
+check_file s "--vcd $tmp/toposort.vcd input/toposort.v" "$tmp/toposort.vcd" \
+    8df7416a5b6de2586f7961880a7c88a2
+check_file s "--vcd $tmp/signals.vcd --vcd-signals a,FF1,x3 input/toposort.v" \
+    "$tmp/signals.vcd" eda73d9be6443a6cc03786a477fc8097
+expect "--vcd declares every signal" \
+    "$(grep '^\$var' "$tmp/toposort.vcd" | cut -d ' ' -f 5 | xargs)" "a b c d FF1 x1 x2 x3 x4"
+expect "--vcd-signals declares a, FF1 and x3" \
+    "$(grep '^\$var' "$tmp/signals.vcd" | cut -d ' ' -f 5 | xargs)" "a FF1 x3"
+# A timestamp at the start of each of the 16 ticks, and one at the end
+expect "--vcd timestamps" "$(grep '^#' "$tmp/toposort.vcd" | xargs)" \
+    "$(seq -f '#%g' 0 16 | xargs)"
+
+# A counter that is reset, then counts for long stretches
+(echo 01; yes 10 | head -n 1000; yes 00 | head -n 3; yes 10 | head -n 1000) > "$tmp/held.txt"
+./convert_vectors "$tmp/held.txt" "$tmp/held.pav"
+check s "--vectors $tmp/held.txt input/counter.v" 347d72d61234d7d335bf40c6f4a2fa25
+
+# Resuming from a checkpoint gives the outputs of the full run after it, from text and binary
+# vectors alike
+for vectors in "$tmp/held.txt" "$tmp/held.pav"
+do
+    ./progetto_algoritmi --mode s --vectors "$vectors" --checkpoint "$tmp/checkpoint" \
+        --checkpoint-every 100 --output "$tmp/full.txt" input/counter.v
+    ./progetto_algoritmi --mode s --vectors "$vectors" --resume "$tmp/checkpoint" \
+        --resume-at 1234 --output "$tmp/tail.txt" input/counter.v
+    expect "--resume-at 1234, $vectors" $(hash < "$tmp/tail.txt") \
+        $(tail -n +1201 "$tmp/full.txt" | hash)
+    # From the checkpoint at tick 1200 to the end, at tick 2003
+    expect "--resume-at 1234, $vectors, 804 ticks" $(wc -l < "$tmp/tail.txt") 804
+done
+# A resumed VCD dump starts at the tick of the checkpoint, and has the timestamps of the full run
+./progetto_algoritmi --mode s --vectors "$tmp/held.txt" --checkpoint "$tmp/checkpoint" \
+    --checkpoint-every 100 --vcd "$tmp/full.vcd" --output /dev/null input/counter.v
+./progetto_algoritmi --mode s --vectors "$tmp/held.txt" --resume "$tmp/checkpoint" \
+    --resume-at 1234 --vcd "$tmp/tail.vcd" --output /dev/null input/counter.v
+expect "--resume-at 1234 --vcd, first timestamp" "$(grep -m 1 '^#' "$tmp/tail.vcd")" "#1200"
+expect "--resume-at 1234 --vcd, timestamps" $(grep '^#' "$tmp/tail.vcd" | hash) \
+    $(grep '^#' "$tmp/full.vcd" | sed -n '/^#1200$/,$p' | hash)
+
+# With the inputs held, the counter goes around the same 8 states, which are replayed instead of
+# evaluated, with the same outputs
+for options in --no-cycle-detection "--engine event" "--engine bitparallel"
+do
+    check s "--vectors $tmp/held.txt $options input/counter.v" 347d72d61234d7d335bf40c6f4a2fa25
+done
+# Only the ticks until a state repeats after the inputs change
+expect "cycle detection evaluates 24 of 2004 ticks" "$(./progetto_algoritmi --mode s \
+    --vectors "$tmp/held.txt" --engine event --verbose input/counter.v 2>&1 > /dev/null |
+    grep -o '[0-9]* ticks')" "24 ticks"
+./progetto_algoritmi --mode s --vectors "$tmp/held.txt" input/counter.v > "$tmp/held.out"
+# 998 counts at tick 999, 6 with the least significant bit first. The inputs are then held at 0 for
+# 3 ticks, and the last tick shows 999 more counts, 7.
+expect "counter.v, tick 999" "$(sed -n 1000p "$tmp/held.out")" 011
+expect "counter.v, tick 2003" "$(sed -n 2004p "$tmp/held.out")" 111
+
+check s "--exhaustive input/single_gates.v" 9eea55ea0c4bb68c759561028e78d515
+check s "--exhaustive-x input/single_gates.v" 8ccfecc5cc23440a96f5f025418676bf
+check s "--exhaustive-x -j 4 input/single_gates.v" 8ccfecc5cc23440a96f5f025418676bf
+check s "--exhaustive-x input/logic_properties.v" 968e970c3ec2f526729b6517f009dd14
+# a AND b is 0 for 5 of the 9 pairs of 0, 1 and X, 1 for one and X for 3, each with 9 values of c
+# and d. a or b is X in 5 of the pairs.
+./progetto_algoritmi --mode s --exhaustive-x input/single_gates.v > "$tmp/exhaustive.txt"
+expect "--exhaustive-x, _and" "$(grep '^_and' "$tmp/exhaustive.txt")" "$(printf '_and\t45\t9\t27')"
+expect "--exhaustive-x, vectors with an X" "$(grep '^Vectors with' "$tmp/exhaustive.txt")" \
+    "Vectors with an X output: 45"
+# An output that is never assigned is X, even without X inputs
+echo -e "module UNASSIGNED (\n\tinput a, b\n\toutput y, z\n);\n\tassign y = a AND b\nendmodule" \
+    > "$tmp/unassigned.v"
+./progetto_algoritmi --mode s --exhaustive "$tmp/unassigned.v" > "$tmp/exhaustive.txt"
+expect "--exhaustive, unassigned output" "$(grep '^z' "$tmp/exhaustive.txt")" \
+    "$(printf 'z\t0\t0\t4')"
+expect "--exhaustive, vectors with an X" "$(grep '^Vectors with' "$tmp/exhaustive.txt")" \
+    "Vectors with an X output: 4"
+# A circuit without flip-flops with more faults than a kernel has lanes, so that the lanes of the
+# faults detected early take new ones: 200 outputs, (ij AND ik) XOR il for distinct pairs j, k
+{
+    echo "module MANY ("
+    echo "	input $(seq -s ', ' -f 'i%g' 0 15)"
+    echo "	output $(seq -s ', ' -f 'y%g' 0 199)"
+    echo ");"
+    for n in $(seq 0 199)
+    do
+        j=$((n % 16)) k=$(((n % 16 + 1 + n / 16) % 16)) l=$(((3 * n + 5) % 16))
+        echo "	assign y$n = (i$j AND i$k) XOR i$l"
+    done
+    echo "endmodule"
+} > "$tmp/many.v"
+{
+    seed=7
+    for i in $(seq 12)
+    do
+        seed=$(((seed * 1103515245 + 12345) % 2147483648))
+        for bit in $(seq 0 15)
+        do
+            echo -n $((seed >> (bit + 8) & 1))
+        done
+        echo
+    done
+} > "$tmp/many.txt"
+check s "--faults input/toposort.v" e2954cc870e658ccd6ce15e40ceeb02d
+check s "--faults input/single_gates.v" e600bdf524ab82e88f0bcad605a0bbdd
+check s "--faults -j 4 input/single_gates.v" e600bdf524ab82e88f0bcad605a0bbdd
+check s "--faults --vectors $tmp/held.txt input/counter.v" f69a1c08673129731542295427a84c13
+./progetto_algoritmi --mode s --faults --vectors input/vectors.txt input/single_gates.v \
+    > "$tmp/faults.txt"
+expect "--faults, input/single_gates.v coverage" "$(head -n 1 "$tmp/faults.txt")" \
+    "Fault simulation: 16 vectors, 22 stuck-at faults, 18 detected (81.82% coverage)"
+expect "--faults, input/single_gates.v undetected" $(($(wc -l < "$tmp/faults.txt") - 2)) 4
+# b is 1 only in the first vector, when the flip-flops are still 0, so a counter that never resets
+# (b stuck at 0, or NOT b stuck at 1) counts the same
+./progetto_algoritmi --mode s --faults --vectors "$tmp/held.txt" input/counter.v > "$tmp/faults.txt"
+expect "--faults, input/counter.v coverage" "$(head -n 1 "$tmp/faults.txt")" \
+    "Fault simulation: 2004 vectors, 34 stuck-at faults, 32 detected (94.12% coverage)"
+expect "--faults, input/counter.v undetected" "$(tail -n +3 "$tmp/faults.txt")" \
+    "$(printf '\tb stuck-at 0\n\tFF0.g0 stuck-at 1')"
+for threads in 1 4
+do
+    ./progetto_algoritmi --mode s --faults -j $threads --vectors "$tmp/many.txt" "$tmp/many.v" \
+        > "$tmp/faults.txt"
+    expect "--faults -j $threads, 672 faults" "$(head -n 1 "$tmp/faults.txt")" \
+        "Fault simulation: 12 vectors, 672 stuck-at faults, 659 detected (98.07% coverage)"
+    expect "--faults -j $threads, 13 undetected" $(($(wc -l < "$tmp/faults.txt") - 2)) 13
+done
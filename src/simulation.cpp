@@ -1,32 +1,44 @@
 #include "simulation.h"
+#include "bitparallel.h"
+#include "checkpoint.h"
+#include "exhaustive.h"
+#include "faults.h"
+#include "native.h"
+#include "steadystate.h"
+#include "vcd.h"
+#include "vectorio.h"
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <optional>
 
 void simulation::Implementation::on_operator(ast::Operator astOperator,
                                              simulation::Engine::OperandStack &stack) {
+	TruthValue lhs = pop(stack);
+	TruthValue rhs = ast::arity(astOperator) == 2 ? pop(stack) : lhs;
+	stack.push(apply(astOperator, lhs, rhs));
+}
+
+// Unary operators ignore `rhs`.
+TruthValue simulation::Implementation::apply(ast::Operator astOperator, TruthValue lhs,
+                                             TruthValue rhs) {
 	switch (astOperator) {
 		case ast::Operator::NOT:
-			stack.push(!pop(stack));
-			break;
+			return !lhs;
 		case ast::Operator::AND:
-			stack.push(pop(stack) && pop(stack));
-			break;
+			return lhs && rhs;
 		case ast::Operator::OR:
-			stack.push(pop(stack) || pop(stack));
-			break;
+			return lhs || rhs;
 		case ast::Operator::XOR:
-			stack.push(pop(stack) ^ pop(stack));
-			break;
+			return lhs ^ rhs;
 		case ast::Operator::NAND:
-			stack.push(!(pop(stack) && pop(stack)));
-			break;
+			return lhs.nand(rhs);
 		case ast::Operator::NOR:
-			stack.push(!(pop(stack) || pop(stack)));
-			break;
+			return lhs.nor(rhs);
 		case ast::Operator::XNOR:
-			stack.push(!(pop(stack) ^ pop(stack)));
-			break;
+			return lhs.xnor(rhs);
 	}
+	throw "Unknown operator"s;
 }
 
 void simulation::Implementation::initialize(std::vector<TruthValue> &state) {
@@ -34,49 +46,224 @@ void simulation::Implementation::initialize(std::vector<TruthValue> &state) {
 	std::fill(state.begin(), state.end(), TruthValue::X);
 }
 
-void simulation::run(const ast::Module &module) {
-	std::cout << "Enter the path to the input vectors file (default: input/vectors.txt): ";
-	std::cin.ignore(); // Skip the newline that's left in the buffer
-	std::string input_filename;
-	std::getline(std::cin, input_filename);
-	if (input_filename.empty())
-		input_filename = "input/vectors.txt";
+// Simulates the vectors one per tick, with any kind of circuit, from the snapshot `resume` if any.
+// Dumps the ticks to `vcd` and saves a snapshot to `checkpoints` every so many ticks, if any.
+template <class Circuit>
+static void simulate(Circuit &ckt, const ast::Module &module, vectorio::VectorReader &vectors,
+                     vectorio::ResultWriter &out, const simulation::Options &options,
+                     vcd::Writer *vcd, checkpoint::Writer *checkpoints,
+                     const checkpoint::Snapshot *resume) {
+	uint64_t linenum = 0;
+	if (resume) {
+		ckt.restore(resume->state, resume->outputs);
+		vectors.seek(resume->offset, resume->tick);
+		linenum = resume->tick;
+	}
+	vectorio::Vector vector, previous;
+	std::vector<TruthValue> inputs(module.input_size());
+	std::string row;
+	auto write = [&](const auto &state, const auto &outputs) {
+		if (vcd)
+			vcd->tick(inputs, state, outputs);
+		if (checkpoints && (linenum + 1) % options.checkpoint_interval == 0)
+			checkpoints->save(linenum + 1, vectors.offset(), state, outputs);
+		row.clear();
+		out.encode(row, outputs);
+		out.write(row, 1);
+	};
 
-	std::ifstream vectors_file(input_filename, std::ios::in);
-	if (vectors_file.fail())
+	steadystate::Detector detector(module.state_size(), module.output_size());
+	const steadystate::Tick *replayed = nullptr; // The last tick that wasn't evaluated, if any
+	for (uint64_t first = linenum; vectors.next(vector); linenum++) {
+		if (vector.size() != module.input_size())
+			throw "Input size mismatch (line " + std::to_string(linenum) + ")";
+		bool held = options.detect_cycles && linenum != first && vector.bytes() == previous.bytes();
+		previous = vector;
+		if (!held) {
+			if (replayed)
+				ckt.restore(replayed->state, replayed->outputs);
+			replayed = nullptr;
+			detector.reset();
+		} else if (detector.cycling()) {
+			STATS_ADD(replayed_ticks, 1);
+			replayed = &detector.advance();
+			write(replayed->state, replayed->outputs);
+			continue;
+		}
+
+		for (size_t i = 0; i < module.input_size(); i++)
+			inputs[i] = vector[i];
+		{
+			STATS_TICKS(1);
+			ckt.evaluate(inputs);
+		}
+		if (held)
+			detector.record(ckt.state(), ckt.outputs());
+		write(ckt.state(), ckt.outputs());
+	}
+}
+
+// The program for the engines that run bytecode
+static bytecode::Program compile(const ast::Module &module, const simulation::Options &options,
+                                 bool keep_state) {
+	STATS_TIME(CONSTRUCTION);
+	bytecode::Program program = bytecode::compile(module);
+	if (!options.optimize)
+		return program;
+	for (const bytecode::PassReport &report : bytecode::optimize(program, keep_state))
+		if (options.verbose)
+			std::cerr << "Optimization pass \"" << report.name << "\": " << report.before << " -> "
+			          << report.after << " instructions" << std::endl;
+	return program;
+}
+
+// Sums up every combination of the inputs rather than simulating a vectors file
+static void run_exhaustive(const ast::Module &module, const simulation::Options &options) {
+	if (!options.vcd.empty() || !options.checkpoints.empty() || !options.resume.empty())
+		throw "Exhaustive simulations can't be dumped or checkpointed"s;
+	exhaustive::Report report =
+	    exhaustive::run(compile(module, options, false), options.exhaustive, options.threads);
+	STATS_TIME(OUTPUT);
+	if (options.output.empty()) {
+		exhaustive::write(std::cout, module, report);
+		return;
+	}
+	std::ofstream output_file(options.output, std::ios::out | std::ios::binary);
+	if (output_file.fail())
 		throw "Failed to open file."s;
+	exhaustive::write(output_file, module, report);
+}
+
+void simulation::run(const ast::Module &module, const Options &options) {
+	if (options.exhaustive != 0)
+		return run_exhaustive(module, options);
+	bool interactive = options.vectors.empty();
+	std::string input_filename = options.vectors;
+	if (interactive) {
+		std::cout << "Enter the path to the input vectors file (default: input/vectors.txt): ";
+		std::getline(std::cin, input_filename);
+		if (input_filename.empty())
+			input_filename = "input/vectors.txt";
+	}
+	vectorio::MappedFile vectors_file(input_filename);
+	vectorio::VectorReader vectors(vectors_file.contents());
 
-	std::cout << "Enter the path to the output file (default: console output): ";
-	std::string output_filename;
-	std::getline(std::cin, output_filename);
+	std::string output_filename = options.output;
+	if (interactive) {
+		std::cout << "Enter the path to the output file (default: console output): ";
+		std::getline(std::cin, output_filename);
+	}
 	std::ofstream output_file;
-	// The pointer is used to get around the fact that you can't copy ostreams
-	// A reference would be better, but it would also require a mess with ternary operators
-	std::ostream *out;
-	if (output_filename.empty()) {
-		out = &std::cout;
-	} else {
-		output_file.open(output_filename);
+	if (!output_filename.empty()) {
+		output_file.open(output_filename, std::ios::out | std::ios::binary);
 		if (output_file.fail())
 			throw "Failed to open file."s;
-		out = &output_file;
 	}
+	if (options.fault_simulation) {
+		if (!options.vcd.empty() || !options.checkpoints.empty() || !options.resume.empty())
+			throw "Fault simulations can't be dumped or checkpointed"s;
+		// The faults are those of the netlist, whatever the optimizations would make of it
+		bytecode::Program program = bytecode::compile(module);
+		faults::Report report = faults::run(program, kernels::widest(), vectors, options.threads);
+		STATS_TIME(OUTPUT);
+		faults::write(output_filename.empty() ? std::cout : output_file, module, program, report);
+		return;
+	}
+	vectorio::ResultWriter out(output_filename.empty() ? std::cout : output_file,
+	                           options.output_format, module.output_size());
 
-	simulation::Implementation impl;
-	simulation::Circuit ckt(module, impl);
+	std::optional<checkpoint::Snapshot> resume;
+	if (!options.resume.empty())
+		resume = checkpoint::load(options.resume, module, options.resume_tick);
+	std::ofstream vcd_file;
+	std::unique_ptr<vcd::Writer> vcd;
+	if (!options.vcd.empty()) {
+		vcd_file.open(options.vcd, std::ios::out | std::ios::binary);
+		if (vcd_file.fail())
+			throw "Failed to open the VCD file."s;
+		vcd = std::make_unique<vcd::Writer>(vcd_file, module, options.vcd_signals,
+		                                    resume ? resume->tick : 0, options.threads != 1);
+	}
+	std::unique_ptr<checkpoint::Writer> checkpoints;
+	if (!options.checkpoints.empty()) {
+		if (options.checkpoint_interval == 0)
+			throw "The checkpoint interval must be positive"s;
+		checkpoints = std::make_unique<checkpoint::Writer>(options.checkpoints, module);
+	}
 
-	std::string line;
-	for (uint32_t linenum = 0; std::getline(vectors_file, line); linenum++) {
-		if (line.size() != module.input_size())
-			throw "Input size mismatch (line " + std::to_string(linenum) + ")";
-		std::vector<TruthValue> inputs(module.input_size());
-		for (size_t i = 0; i < module.input_size(); i++)
-			inputs[i] = line[i] - '0';
+	bool keep_state = (vcd && vcd->dumps_state()) || checkpoints;
 
-		ckt.evaluate(inputs);
+	using Evaluator = Options::Evaluator;
+	Evaluator evaluator = options.evaluator;
+	bool sequential = vcd || checkpoints || resume; // Needs the ticks one at a time
+	if (sequential && (evaluator == Evaluator::BIT_PARALLEL || evaluator == Evaluator::NATIVE))
+		throw "VCD dumps and checkpoints need the interpreted, compiled or event-driven engine"s;
+	std::optional<bytecode::Program> native_program;
+	std::unique_ptr<native::Library> library;
+	if (evaluator == Evaluator::NATIVE) {
+		try {
+			native_program = compile(module, options, keep_state);
+			STATS_TIME(CONSTRUCTION);
+			library = std::make_unique<native::Library>(*native_program);
+		} catch (std::string &e) {
+			std::cerr << "Native compilation is not available, falling back to the default engine: "
+			          << e << std::endl;
+			evaluator = Evaluator::AUTO;
+		}
+	}
+	if (evaluator == Evaluator::AUTO)
+		evaluator =
+		    module.state_size() == 0 && !sequential ? Evaluator::BIT_PARALLEL : Evaluator::COMPILED;
 
-		for (const TruthValue &bit : ckt.outputs())
-			*out << bit.toChar();
-		*out << std::endl;
+	simulation::Implementation impl;
+	switch (evaluator) {
+		case Evaluator::INTERPRETED: {
+			simulation::Circuit ckt(module, impl);
+			simulate(ckt, module, vectors, out, options, vcd.get(), checkpoints.get(),
+			         resume ? &*resume : nullptr);
+			break;
+		}
+		case Evaluator::AUTO:
+		case Evaluator::COMPILED: {
+			// The only parallelism that works with flip-flops is within a tick, and it needs
+			// levels wide enough to be worth starting the threads
+			simulation::CompiledCircuit ckt(compile(module, options, keep_state), impl);
+			std::optional<ThreadPool> pool;
+			if (options.threads != 1 && ckt.parallelizable()) {
+				pool.emplace(options.threads);
+				if (pool->size() > 1)
+					ckt.parallelize(*pool);
+			}
+			simulate(ckt, module, vectors, out, options, vcd.get(), checkpoints.get(),
+			         resume ? &*resume : nullptr);
+			break;
+		}
+		case Evaluator::BIT_PARALLEL: {
+			// Without flip-flops every vector is independent of the others, so they can be
+			// evaluated in parallel. With flip-flops only one lane is used, and the scalar kernel
+			// evaluates it with the least work.
+			const kernels::Kernel &kernel =
+			    module.state_size() == 0 ? kernels::widest() : kernels::available().front();
+			bitparallel::run(compile(module, options, keep_state), kernel, vectors, out,
+			                 options.threads);
+			break;
+		}
+		case Evaluator::EVENT_DRIVEN: {
+			simulation::EventDrivenCircuit ckt(compile(module, options, keep_state), impl);
+			simulate(ckt, module, vectors, out, options, vcd.get(), checkpoints.get(),
+			         resume ? &*resume : nullptr);
+			if (options.verbose) {
+				out.flush();
+				const auto &stats = ckt.stats;
+				uint64_t total = stats.evaluated + stats.skipped;
+				std::cerr << "Event-driven simulation: " << stats.ticks << " ticks, "
+				          << stats.evaluated << " evaluations, " << stats.skipped << " skipped ("
+				          << (total ? 100 * stats.skipped / total : 0) << "%)" << std::endl;
+			}
+			break;
+		}
+		case Evaluator::NATIVE:
+			bitparallel::run(*native_program, library->kernel(), vectors, out, options.threads);
+			break;
 	}
-}
\ No newline at end of file
+}
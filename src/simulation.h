@@ -2,6 +2,7 @@
 
 #include "generic.hpp"
 #include "truthvalue.h"
+#include "vectorio.h"
 
 namespace simulation {
 	class Implementation;
@@ -11,10 +12,48 @@ namespace simulation {
 	  public:
 		static void initialize(std::vector<TruthValue> &state);
 		static void on_operator(ast::Operator, Engine::OperandStack &stack);
+		static TruthValue apply(ast::Operator, TruthValue lhs, TruthValue rhs);
 	};
 
 	using StackMachine = Engine::StackMachine;
 	using Circuit = Engine::Circuit;
+	using CompiledCircuit = Engine::CompiledCircuit;
+	using EventDrivenCircuit = Engine::EventDrivenCircuit;
 
-	void run(const ast::Module &);
+	struct Options {
+		enum class Evaluator { AUTO, INTERPRETED, COMPILED, BIT_PARALLEL, EVENT_DRIVEN, NATIVE };
+		// AUTO is BIT_PARALLEL for circuits without flip-flops and COMPILED otherwise, or with a
+		// VCD dump or checkpoints. NATIVE falls back to AUTO if the circuit can't be compiled.
+		Evaluator evaluator = Evaluator::AUTO;
+		// Worker threads for parsing large netlists, simulating many vectors at once or the
+		// independent assignments of very wide circuits, and listing logic cones; 0 means one per
+		// core
+		size_t threads = 0;
+		// The vectors file and the output file; if `vectors` is empty, they are asked
+		// interactively. An empty `output` means the console.
+		std::string vectors, output;
+		// Vectors files are read in either format, see vectorio.h
+		vectorio::Format output_format = vectorio::Format::TEXT;
+		// Whether to run bytecode::optimize, and to print what each pass did on stderr
+		bool optimize = true, verbose = false;
+		// Whether to replay the ticks instead of evaluating them once the inputs are held and the
+		// state repeats, see steadystate.h
+		bool detect_cycles = true;
+		// If not 0, every combination of 0 and 1, or with 3 of X as well, is simulated on its own
+		// instead of the vectors, and the outputs are summed up (see exhaustive.h)
+		unsigned exhaustive = 0;
+		// Whether to grade the vectors by the stuck-at faults they detect instead (see faults.h)
+		bool fault_simulation = false;
+		// Where to dump the signals of every tick (see vcd.h), if not empty, and which ones; all of
+		// them if `vcd_signals` is empty. The bit-parallel engines can't dump them.
+		std::string vcd;
+		std::vector<std::string> vcd_signals;
+		// Where to save a snapshot every `checkpoint_interval` ticks, if not empty, and the
+		// snapshots to resume from, at the latest one at or before `resume_tick` (see
+		// checkpoint.h). The bit-parallel engines can't do either.
+		std::string checkpoints, resume;
+		uint64_t checkpoint_interval = 1000000, resume_tick = UINT64_MAX;
+	};
+
+	void run(const ast::Module &, const Options &);
 } // namespace simulation
\ No newline at end of file
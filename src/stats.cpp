@@ -0,0 +1,73 @@
+#include "stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+stats::Counters stats::counters;
+
+void stats::raise(std::atomic<uint64_t> &counter, uint64_t value) {
+	uint64_t current = counter.load(std::memory_order_relaxed);
+	while (value > current && !counter.compare_exchange_weak(current, value))
+		;
+}
+
+stats::Timer::~Timer() {
+	uint64_t elapsed =
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	counters.nanoseconds[size_t(phase)].fetch_add(elapsed, std::memory_order_relaxed);
+	if (ticks == 0)
+		return;
+	counters.ticks.fetch_add(ticks, std::memory_order_relaxed);
+	size_t bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+	counters.latencies[std::min(bucket, LATENCY_BUCKETS - 1)].fetch_add(1,
+	                                                                     std::memory_order_relaxed);
+}
+
+void stats::write_json(std::ostream &out) {
+	static const char *phases[PHASE_COUNT] = {"parse", "toposort", "construction", "ticks",
+	                                          "output"};
+	uint64_t ticks = counters.ticks, evaluations = counters.evaluations;
+	out << "{\n\t\"seconds\": {";
+	for (size_t i = 0; i < PHASE_COUNT; i++)
+		out << (i ? ", " : "") << '"' << phases[i] << "\": " << counters.nanoseconds[i] * 1e-9;
+	out << "},\n\t\"ticks\": " << ticks << ",\n\t\"replayed_ticks\": " << counters.replayed_ticks
+	    << ",\n\t\"evaluations\": " << evaluations
+	    << ",\n\t\"evaluations_per_tick\": " << (ticks ? double(evaluations) / ticks : 0)
+	    << ",\n\t\"max_stack_depth\": " << counters.max_stack_depth
+	    << ",\n\t\"allocations\": " << counters.allocations << ",\n\t\"tick_latency_ns\": {";
+	// Keyed by the lower bound of each non-empty bucket
+	bool first = true;
+	for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+		if (counters.latencies[i] == 0)
+			continue;
+		out << (first ? "" : ", ") << '"' << (i ? uint64_t(1) << i : 0)
+		    << "\": " << counters.latencies[i];
+		first = false;
+	}
+	out << "}\n}" << std::endl;
+}
+
+#ifdef STATS
+// Counts the allocations of the whole program. The array and nothrow forms call these.
+void *operator new(std::size_t size) {
+	STATS_ADD(allocations, 1);
+	if (void *pointer = std::malloc(size ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+	STATS_ADD(allocations, 1);
+	// aligned_alloc wants a multiple of the alignment
+	size_t align = size_t(alignment);
+	size_t padded = (std::max<size_t>(size, 1) + align - 1) / align * align;
+	if (void *pointer = std::aligned_alloc(align, padded))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+/* Counters and timers on the hot paths, printed as JSON by --stats. They are only compiled into
+ * builds with STATS defined (cmake -DSTATS=ON); otherwise the macros below expand to nothing.
+ *
+ * Counters are atomic, so that threads can update them. The time of a phase is summed over the
+ * threads that run it.
+ */
+namespace stats {
+#ifdef STATS
+	constexpr bool ENABLED = true;
+#else
+	constexpr bool ENABLED = false;
+#endif
+
+	enum class Phase { PARSE, TOPOSORT, CONSTRUCTION, TICKS, OUTPUT };
+	constexpr size_t PHASE_COUNT = 5;
+	// Bucket i counts the evaluations of the circuit that took [2^i, 2^(i + 1)) ns
+	constexpr size_t LATENCY_BUCKETS = 40;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct Counters {
+		std::atomic<uint64_t> nanoseconds[PHASE_COUNT];
+		// A tick simulates a vector. The bit-parallel engine simulates a batch of them in one
+		// evaluation of the circuit, which counts as one sample of the latency.
+		std::atomic<uint64_t> ticks, evaluations, allocations;
+		// Ticks that repeated earlier ones, and weren't evaluated (see steadystate.h)
+		std::atomic<uint64_t> replayed_ticks;
+		std::atomic<uint64_t> max_stack_depth;
+		std::atomic<uint64_t> latencies[LATENCY_BUCKETS];
+	};
+	extern Counters counters;
+
+	void raise(std::atomic<uint64_t> &counter, uint64_t value);
+
+	// Adds the time from construction to destruction to `phase`
+	class Timer {
+		Phase phase;
+		uint64_t ticks;
+		Clock::time_point start = Clock::now();
+
+	  public:
+		// `ticks` is the number of vectors that a TICKS timer simulates
+		explicit Timer(Phase phase, uint64_t ticks = 0) : phase(phase), ticks(ticks) {}
+		~Timer();
+		Timer(const Timer &) = delete;
+		Timer &operator=(const Timer &) = delete;
+	};
+
+	void write_json(std::ostream &);
+} // namespace stats
+
+#ifdef STATS
+#define STATS_TIME(phase) ::stats::Timer stats_timer(::stats::Phase::phase)
+#define STATS_TICKS(ticks) ::stats::Timer stats_timer(::stats::Phase::TICKS, ticks)
+#define STATS_ADD(counter, n) ::stats::counters.counter.fetch_add(n, std::memory_order_relaxed)
+#define STATS_MAX(counter, n) ::stats::raise(::stats::counters.counter, n)
+#else
+#define STATS_TIME(phase)
+#define STATS_TICKS(ticks)
+#define STATS_ADD(counter, n)
+#define STATS_MAX(counter, n)
+#endif
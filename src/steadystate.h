@@ -0,0 +1,77 @@
+#pragma once
+
+#include "truthvalue.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* While the inputs are held, a circuit with flip-flops either settles or cycles through a few
+ * states, since each tick only depends on the state that the previous one left. Once the state
+ * after a tick matches an earlier one, the ticks that followed it repeat, so their outputs can be
+ * replayed instead of evaluated until the inputs change.
+ *
+ * The states are looked up by their packed values. The history is bounded, so long cycles go
+ * undetected.
+ */
+namespace steadystate {
+	struct Tick {
+		std::vector<TruthValue> state, outputs;
+	};
+
+	class Detector {
+		static constexpr size_t MAX_TICKS = 1024;
+		static constexpr size_t MAX_BYTES = 16 << 20;
+		static constexpr size_t NONE = SIZE_MAX;
+
+		size_t limit;
+		std::vector<Tick> history; // Since the inputs were last changed
+		std::unordered_map<std::string, size_t> seen; // The tick that left each state
+		std::string key;
+		size_t first = 0, next = NONE; // The cycle starts at history[first]
+
+		template <class Values>
+		static std::vector<TruthValue> copy(const Values &values) {
+			std::vector<TruthValue> copy(values.size());
+			for (size_t i = 0; i < values.size(); i++)
+				copy[i] = values[i];
+			return copy;
+		}
+
+	  public:
+		Detector(size_t state_size, size_t output_size)
+		    : limit(std::min(MAX_TICKS, MAX_BYTES / (1 + state_size + output_size))) {}
+
+		// The inputs changed, so the history doesn't apply anymore
+		void reset() {
+			history.clear();
+			seen.clear();
+			next = NONE;
+		}
+
+		// Whether the ticks repeat, so that advance() can stand for them
+		bool cycling() const { return next != NONE; }
+
+		// Records an evaluated tick, with the same inputs as the previous ones in the history
+		template <class State, class Outputs>
+		void record(const State &state, const Outputs &outputs) {
+			if (history.size() == limit)
+				return;
+			key.assign((state.size() + 3) / 4, '\0');
+			for (size_t i = 0; i < state.size(); i++)
+				key[i / 4] |= char(TruthValue(state[i]).code() << (2 * (i % 4)));
+			auto [it, inserted] = seen.emplace(key, history.size());
+			history.push_back({copy(state), copy(outputs)});
+			if (!inserted)
+				first = next = it->second + 1;
+		}
+
+		// The tick that the next one repeats
+		const Tick &advance() {
+			const Tick &tick = history[next];
+			next = next + 1 == history.size() ? first : next + 1;
+			return tick;
+		}
+	};
+} // namespace steadystate
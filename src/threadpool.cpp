@@ -0,0 +1,74 @@
+#include "threadpool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (size_t i = 1; i < threads; i++)
+		workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread &worker : workers)
+		worker.join();
+}
+
+// Claims tasks from the current batch until there are none left
+void ThreadPool::work() {
+	for (size_t i; (i = next_task++) < task_count;) {
+		try {
+			(*task)(i);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+}
+
+void ThreadPool::worker_loop() {
+	uint64_t seen_generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+		work();
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)> &task) {
+	if (workers.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		task_count = count;
+		next_task = 0;
+		busy = workers.size();
+		error = nullptr;
+		generation++;
+	}
+	wake.notify_all();
+	work();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [&] { return busy == 0; });
+	if (error)
+		std::rethrow_exception(error);
+}
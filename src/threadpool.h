@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A fixed set of threads that run batches of tasks. The thread that submits a batch works on it as
+ * well, so a pool of size 1 has no threads of its own and simply runs everything inline.
+ */
+class ThreadPool {
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	uint64_t generation = 0; // Incremented for each batch
+	bool stopping = false;
+	size_t busy = 0; // Workers that haven't finished the current batch yet
+
+	const std::function<void(size_t)> *task = nullptr;
+	size_t task_count = 0;
+	std::atomic<size_t> next_task{0};
+	std::exception_ptr error;
+
+	void work();
+	void worker_loop();
+
+  public:
+	// 0 means one thread per core
+	explicit ThreadPool(size_t threads);
+	~ThreadPool();
+
+	size_t size() const { return workers.size() + 1; }
+
+	// Runs `task(i)` for every i in [0, count) and waits for all of them to finish. If a task
+	// throws, the first exception is rethrown here.
+	void parallel_for(size_t count, const std::function<void(size_t)> &task);
+};
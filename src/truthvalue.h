@@ -1,7 +1,13 @@
 #pragma once
 
+#include "utils.h"
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
 class TruthValue {
-	enum class Values { X = -1, FALSE = 0, TRUE = 1 };
+	// The codes are the same as in TruthValueVector and in binary vector files (see vectorio.h)
+	enum class Values : uint8_t { FALSE = 0, TRUE = 1, X = 2 };
 
   public:
 	static constexpr Values X = Values::X;
@@ -11,24 +17,97 @@ class TruthValue {
   private:
 	Values value;
 
+	using Table = Values[3][3];
+	static constexpr Values F = FALSE, T = TRUE;
+
+	// Indexed by the codes of the two operands. The implementation matches the behaviour of
+	// Verilog with respect to X values.
+	static constexpr Table AND = {{F, F, F}, {F, T, X}, {F, X, X}};
+	static constexpr Table OR = {{F, T, X}, {T, T, T}, {X, T, X}};
+	static constexpr Table XOR = {{F, T, X}, {T, F, X}, {X, X, X}};
+	static constexpr Table NAND = {{T, T, T}, {T, F, X}, {T, X, X}};
+	static constexpr Table NOR = {{T, F, X}, {F, F, F}, {X, F, X}};
+	static constexpr Table XNOR = {{T, F, X}, {F, T, X}, {X, X, X}};
+	// Ignores the second operand
+	static constexpr Table NOT = {{T, T, T}, {F, F, F}, {X, X, X}};
+
+	constexpr TruthValue lookup(const Table &table, TruthValue a) const {
+		return table[uint8_t(value)][uint8_t(a.value)];
+	}
+
   public:
-	TruthValue() : value(X){};
-	TruthValue(bool src) : value(src ? TRUE : FALSE){};
-	TruthValue(Values src) : value(src) {}
+	constexpr TruthValue() : value(X){};
+	constexpr TruthValue(bool src) : value(src ? TRUE : FALSE){};
+	constexpr TruthValue(Values src) : value(src) {}
+
+	// Any code but 0 and 1 is X
+	static constexpr TruthValue from_code(uint8_t code) {
+		return code < 2 ? Values(code) : X;
+	}
+	constexpr uint8_t code() const { return uint8_t(value); }
 
 	// This is a "programmer's equality", it does NOT propagate X values unlike
 	// the "==" operator in Verilog.
-	bool operator==(TruthValue a) const;
+	constexpr bool operator==(TruthValue a) const { return value == a.value; }
 
 	// These could very well be implemented in gates.cpp for the sake of this
 	// assignment, but implementing custom operators allow a developer to write
 	// arbitrarily complex Boolean expressions in eg. more complex gates.
-	// Also, note that the implementation matches the behaviour of Verilog with
-	// respect to X values.
-	TruthValue operator&&(TruthValue a) const;
-	TruthValue operator||(TruthValue a) const;
-	TruthValue operator^(TruthValue a) const;
-	TruthValue operator!() const;
-
-	char toChar() const;
+	constexpr TruthValue operator&&(TruthValue a) const { return lookup(AND, a); }
+	constexpr TruthValue operator||(TruthValue a) const { return lookup(OR, a); }
+	constexpr TruthValue operator^(TruthValue a) const { return lookup(XOR, a); }
+	constexpr TruthValue operator!() const { return lookup(NOT, *this); }
+	constexpr TruthValue nand(TruthValue a) const { return lookup(NAND, a); }
+	constexpr TruthValue nor(TruthValue a) const { return lookup(NOR, a); }
+	constexpr TruthValue xnor(TruthValue a) const { return lookup(XNOR, a); }
+
+	constexpr char toChar() const { return "01x"[uint8_t(value)]; }
+};
+
+// A vector of TruthValues packed with 2 bits each, four per byte, in the order of the binary
+// vector files. Elements are read by value and written through a proxy, like std::vector<bool>.
+class TruthValueVector {
+	std::vector<uint8_t> bytes;
+	size_t count = 0;
+
+	// Four copies of the code of `value`
+	static uint8_t fill(TruthValue value) { return uint8_t(value.code() * 0x55); }
+
+  public:
+	class Reference {
+		uint8_t &byte;
+		unsigned shift;
+
+	  public:
+		Reference(uint8_t &byte, unsigned shift) : byte(byte), shift(shift) {}
+		operator TruthValue() const { return TruthValue::from_code((byte >> shift) & 3); }
+		Reference &operator=(TruthValue value) {
+			byte = uint8_t((byte & ~(3 << shift)) | (value.code() << shift));
+			return *this;
+		}
+		Reference &operator=(const Reference &other) { return *this = TruthValue(other); }
+	};
+
+	TruthValueVector() = default;
+	explicit TruthValueVector(size_t size, TruthValue value = TruthValue())
+	    : bytes((size + 3) / 4, fill(value)), count(size) {}
+
+	template <class Iterator>
+	void assign(Iterator first, Iterator last) {
+		count = std::distance(first, last);
+		bytes.assign((count + 3) / 4, 0);
+		for (size_t i = 0; first != last; ++first, i++)
+			(*this)[i] = *first;
+	}
+
+	size_t size() const { return count; }
+	TruthValue operator[](size_t i) const {
+		return TruthValue::from_code((bytes[i / 4] >> (2 * (i % 4))) & 3);
+	}
+	Reference operator[](size_t i) { return {bytes[i / 4], unsigned(2 * (i % 4))}; }
+};
+
+template <>
+struct ValueVector<TruthValue> {
+	using type = TruthValueVector;
 };
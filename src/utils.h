@@ -1,15 +1,29 @@
 #pragma once
 
+#include <cstdint>
 #include <deque>
 #include <stack>
 #include <string>
+#include <string_view>
+#include <vector>
 
 // Allows to throw strings easily: `throw "error message"s`
 using namespace std::string_literals;
 
-// Pop and return the popped item (unlike std::stack::pop)
+// Inline even in debug builds. Used by code that is instantiated inside SIMD kernels, which must be
+// compiled for the instruction set of the kernel rather than the default one.
+#define ALWAYS_INLINE __attribute__((always_inline)) inline
+
+// The container for the state and the outputs of the interpreted circuits of T. Types with a more
+// compact representation specialize it (see TruthValueVector).
 template <typename T>
-T pop(std::stack<T> &stack) {
+struct ValueVector {
+	using type = std::vector<T>;
+};
+
+// Pop and return the popped item (unlike std::stack::pop)
+template <typename T, typename Container>
+T pop(std::stack<T, Container> &stack) {
 	T ret = stack.top();
 	stack.pop();
 	return ret;
@@ -21,3 +35,31 @@ T pop_back(std::deque<T> &deque) {
 	deque.pop_back();
 	return ret;
 }
+
+
+// A read-only view over contiguous items, like a minimal std::span
+template <typename T>
+class Slice {
+	const T *first, *last;
+
+  public:
+	Slice(const T *first, const T *last) : first(first), last(last) {}
+	const T *begin() const { return first; }
+	const T *end() const { return last; }
+	size_t size() const { return last - first; }
+	const T &operator[](size_t i) const { return first[i]; }
+};
+
+// The little-endian number in `bytes`, as stored in the binary files
+inline uint64_t read_le(std::string_view bytes) {
+	uint64_t value = 0;
+	for (size_t i = bytes.size(); i-- > 0;)
+		value = (value << 8) | uint8_t(bytes[i]);
+	return value;
+}
+
+// Appends the `size` lowest bytes of `value`, little-endian
+inline void write_le(std::string &out, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; i++, value >>= 8)
+		out += char(value & 0xff);
+}
@@ -0,0 +1,87 @@
+#include "vcd.h"
+#include "utils.h"
+#include <algorithm>
+#include <unordered_map>
+
+// Identifier codes are numbers in base 94, written with the printable ASCII characters
+static std::string identifier_code(size_t index) {
+	std::string code;
+	do {
+		code += char('!' + index % 94);
+		index /= 94;
+	} while (index > 0);
+	return code;
+}
+
+vcd::Writer::Writer(std::ostream &out, const ast::Module &module,
+                    const std::vector<std::string> &signals, uint64_t start, bool background)
+    : out(out), start(start), time(start) {
+	std::unordered_map<std::string, bool> requested; // Whether each name was found
+	for (const std::string &name : signals)
+		requested[name] = false;
+	auto selected = [&](const std::string &name) {
+		if (signals.empty())
+			return true;
+		auto it = requested.find(name);
+		if (it == requested.end())
+			return false;
+		it->second = true;
+		return true;
+	};
+
+	std::string header =
+	    "$version progetto_algoritmi $end\n$timescale 1 ns $end\n$scope module circuit $end\n";
+	size_t dumped = 0;
+	auto declare = [&](const char *scope, std::vector<Signal> &signals, size_t count, auto token) {
+		header += "$scope module "s + scope + " $end\n";
+		for (size_t i = 0; i < count; i++) {
+			std::string name = module.name_of(decltype(token){i});
+			if (!selected(name))
+				continue;
+			std::string code = identifier_code(dumped++);
+			Signal signal{i, {}, uint8_t(code.size() + 2), TruthValue::X};
+			std::string change = "x" + code + "\n";
+			std::copy(change.begin(), change.end(), signal.change);
+			signals.push_back(signal);
+			header += "$var wire 1 " + code + " " + name + " $end\n";
+		}
+		header += "$upscope $end\n";
+	};
+	declare("inputs", inputs, module.input_size(), ast::Input{});
+	declare("flipflops", flipflops, module.state_size(), ast::Flipflop{});
+	declare("outputs", outputs, module.output_size(), ast::Output{});
+	header += "$upscope $end\n$enddefinitions $end\n";
+
+	for (const auto &[name, found] : requested)
+		if (!found)
+			throw "Unknown signal to dump: " + name;
+	out.write(header.data(), header.size());
+
+	// The time, its newline and a line per signal, the last one copied as a whole
+	tick_size = 22 + sizeof(Signal::change) * (dumped + 1);
+	buffer.resize(CAPACITY + tick_size);
+	if (background)
+		this->background = std::make_unique<BackgroundWriter>(out);
+}
+
+vcd::Writer::~Writer() {
+	// The end of the last tick
+	char *end = buffer.data() + used;
+	*end++ = '#';
+	end = std::to_chars(end, end + 20, time).ptr;
+	*end++ = '\n';
+	used = end - buffer.data();
+	flush();
+	background.reset();
+	out.flush();
+}
+
+void vcd::Writer::flush() {
+	if (background) {
+		buffer.resize(used);
+		background->write(buffer);
+		buffer.resize(CAPACITY + tick_size);
+	} else
+		out.write(buffer.data(), used);
+	used = 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ast.h"
+#include "backgroundwriter.h"
+#include "truthvalue.h"
+#include <charconv>
+#include <cstring>
+#include <memory>
+#include <ostream>
+
+/* Dumps the inputs, the flip-flops and the outputs of every tick to a Value Change Dump, which
+ * waveform viewers such as GTKWave can display. Tick n is at time n; the flip-flops hold the values
+ * latched at the end of the tick.
+ *
+ * Only the signals that changed since the previous tick are written. Like vectorio::ResultWriter,
+ * the dump is collected in a large buffer, which can be written by a background thread while the
+ * simulation goes on.
+ */
+namespace vcd {
+	class Writer {
+		static constexpr size_t CAPACITY = 1 << 20;
+
+		struct Signal {
+			size_t offset; // Among the inputs, the flip-flops or the outputs
+			// The line that records a change: a placeholder for the value, the identifier code
+			// and a newline
+			char change[8];
+			uint8_t length;
+			TruthValue value; // As of the previous tick
+		};
+
+		std::ostream &out;
+		std::vector<Signal> inputs, flipflops, outputs; // Only those that are dumped
+		const uint64_t start; // The time of the first tick, where every signal is written
+		uint64_t time;
+		// Has room for CAPACITY bytes plus a whole tick, of which `used` are filled
+		std::string buffer;
+		size_t used = 0, tick_size = 0;
+
+		std::unique_ptr<BackgroundWriter> background; // If the buffers are written by a thread
+
+		/* Changes are unpredictable, so rather than branching on them, every line is copied and
+		 * `end` only moves past those that changed. Every signal changes at the first tick.
+		 */
+		template <class Values>
+		void record(std::vector<Signal> &signals, const Values &values, char *&end) {
+			for (Signal &signal : signals) {
+				TruthValue value = values[signal.offset];
+				bool changed = time == start || !(value == signal.value);
+				signal.value = value;
+				std::memcpy(end, signal.change, sizeof(signal.change));
+				*end = value.toChar();
+				end += changed * signal.length;
+			}
+		}
+		void flush();
+
+	  public:
+		// `signals` are the names of the signals to dump, or empty for all of them. The first tick
+		// is at time `start`, the tick a resumed simulation starts from. With `background`, the
+		// file is written by another thread.
+		Writer(std::ostream &out, const ast::Module &module,
+		       const std::vector<std::string> &signals, uint64_t start, bool background);
+		~Writer();
+		Writer(const Writer &) = delete;
+		Writer &operator=(const Writer &) = delete;
+
+		// Whether any flip-flop is dumped, so that the simulation must keep all of them up to date
+		bool dumps_state() const { return !flipflops.empty(); }
+
+		// The time is written first, and taken back if nothing changed
+		template <class Inputs, class State, class Outputs>
+		void tick(const Inputs &inputs, const State &state, const Outputs &outputs) {
+			char *end = buffer.data() + used;
+			*end++ = '#';
+			end = std::to_chars(end, end + 20, time).ptr;
+			*end++ = '\n';
+			char *changes = end;
+			record(this->inputs, inputs, end);
+			record(flipflops, state, end);
+			record(this->outputs, outputs, end);
+			if (end != changes)
+				used = end - buffer.data();
+			time++;
+			if (used >= CAPACITY)
+				flush();
+		}
+	};
+} // namespace vcd
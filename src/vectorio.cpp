@@ -0,0 +1,196 @@
+#include "vectorio.h"
+#include "utils.h"
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+vectorio::MappedFile::MappedFile(const std::string &path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw "Failed to open file."s;
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+		void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (address != MAP_FAILED) {
+			madvise(address, info.st_size, MADV_SEQUENTIAL);
+			data = static_cast<const char *>(address);
+			size = info.st_size;
+			mapped = true;
+		}
+	}
+	close(fd);
+
+	if (!mapped) {
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (file.fail())
+			throw "Failed to open file."s;
+		std::stringstream contents;
+		contents << file.rdbuf();
+		fallback = contents.str();
+		data = fallback.data();
+		size = fallback.size();
+	}
+}
+
+vectorio::MappedFile::~MappedFile() {
+	if (mapped)
+		munmap(const_cast<char *>(data), size);
+}
+
+// The header described in vectorio.h: the magic, then these fields
+static constexpr std::string_view MAGIC = "PAV1";
+static constexpr size_t HEADER_SIZE = 24;
+namespace {
+	struct Field {
+		size_t offset, size;
+	};
+} // namespace
+static constexpr Field BITS{4, 4}, WIDTH{8, 8}, COUNT{16, 8};
+
+namespace {
+	struct Header {
+		unsigned bits;
+		size_t width;
+		uint64_t count;
+
+		size_t stride() const { return (bits * width + 7) / 8; }
+	};
+} // namespace
+
+static bool is_binary(std::string_view contents) {
+	return contents.substr(0, MAGIC.size()) == MAGIC;
+}
+
+static Header read_header(std::string_view contents) {
+	if (contents.size() < HEADER_SIZE)
+		throw "The vectors file is truncated"s;
+	auto field = [&](Field field) { return read_le(contents.substr(field.offset, field.size)); };
+	Header header{unsigned(field(BITS)), field(WIDTH), field(COUNT)};
+	if (header.bits != 1 && header.bits != 2)
+		throw "Unsupported vectors file (" + std::to_string(header.bits) + " bits per value)";
+	if (header.width != 0 && (contents.size() - HEADER_SIZE) / header.stride() < header.count)
+		throw "The vectors file is truncated"s;
+	return header;
+}
+
+static std::string header(const Header &header) {
+	std::string out(MAGIC);
+	write_le(out, header.bits, BITS.size);
+	write_le(out, header.width, WIDTH.size);
+	write_le(out, header.count, COUNT.size);
+	return out;
+}
+
+vectorio::VectorReader::VectorReader(std::string_view contents)
+    : contents(contents), remaining(contents) {
+	if (!is_binary(contents))
+		return;
+	Header header = read_header(contents);
+	_format = Format::BINARY;
+	width = header.width;
+	bits = header.bits;
+	stride = header.stride();
+	count = left = header.count;
+	remaining = contents.substr(HEADER_SIZE);
+}
+
+void vectorio::VectorReader::seek(size_t offset, uint64_t vectors) {
+	bool valid = offset <= contents.size();
+	if (_format == Format::BINARY)
+		valid = valid && vectors <= count && offset == HEADER_SIZE + vectors * stride;
+	else // At the start of a line
+		valid = valid && (offset == 0 || contents[offset - 1] == '\n');
+	if (!valid)
+		throw "The offset doesn't match the vectors file"s;
+	remaining = contents.substr(offset);
+	// Only binary files count the vectors, and `vectors` <= `count` was checked for them
+	left = _format == Format::BINARY ? count - vectors : 0;
+}
+
+vectorio::ResultWriter::ResultWriter(std::ostream &out, Format format, size_t width)
+    : out(out), format(format), width(width) {
+	if (format == Format::TEXT)
+		buffer.reserve(CAPACITY);
+}
+
+void vectorio::ResultWriter::write(std::string_view rows, uint64_t count) {
+	buffer += rows;
+	this->count += count;
+	if (format == Format::TEXT && buffer.size() >= CAPACITY)
+		flush();
+}
+
+void vectorio::ResultWriter::flush() {
+	if (format != Format::TEXT)
+		return;
+	STATS_TIME(OUTPUT);
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+	buffer.clear();
+}
+
+// Repacks vectors with 2 bits per value to 1 bit per value. Requires that there are no X values.
+static std::string narrow(std::string_view rows, size_t width, uint64_t count) {
+	size_t wide_stride = (2 * width + 7) / 8, narrow_stride = (width + 7) / 8;
+	std::string out(count * narrow_stride, '\0');
+	for (uint64_t vector = 0; vector < count; vector++) {
+		const char *wide = rows.data() + vector * wide_stride;
+		char *narrow = out.data() + vector * narrow_stride;
+		for (size_t i = 0; i < width; i++)
+			narrow[i / 8] |= char(((uint8_t(wide[i / 4]) >> (2 * (i % 4))) & 1) << (i % 8));
+	}
+	return out;
+}
+
+// Whether vectors with 2 bits per value contain X values, ie. a 1 in the high bit of any value
+static bool has_x(std::string_view rows) {
+	for (char byte : rows)
+		if (uint8_t(byte) & 0xaa)
+			return true;
+	return false;
+}
+
+void vectorio::ResultWriter::finish() {
+	if (finished)
+		return;
+	finished = true;
+	STATS_TIME(OUTPUT);
+	if (format == Format::BINARY) {
+		bool narrow = !has_x(buffer);
+		out << header({narrow ? 1u : 2u, width, count});
+		if (narrow)
+			buffer = ::narrow(buffer, width, count);
+	}
+	out.write(buffer.data(), buffer.size());
+	out.flush();
+	buffer.clear();
+}
+
+std::string vectorio::convert(std::string_view contents) {
+	VectorReader reader(contents);
+	std::vector<Vector> vectors;
+	Vector vector;
+	while (reader.next(vector)) {
+		if (!vectors.empty() && vector.size() != vectors[0].size())
+			throw "Vector size mismatch (line " + std::to_string(vectors.size()) + ")";
+		vectors.push_back(vector);
+	}
+
+	std::ostringstream out;
+	{
+		Format format = reader.format() == Format::TEXT ? Format::BINARY : Format::TEXT;
+		ResultWriter writer(out, format, vectors.empty() ? 0 : vectors[0].size());
+		std::string rows;
+		for (const Vector &vector : vectors) {
+			rows.clear();
+			writer.encode(rows, vector);
+			writer.write(rows, 1);
+		}
+	}
+	return out.str();
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "stats.h"
+#include "truthvalue.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/* Fast I/O for the vectors and the outputs of the simulation. Input files are memory-mapped and
+ * decoded in place, and outputs are collected in a large buffer that is written out in bulk,
+ * rather than flushed after every line.
+ *
+ * Besides text, with one character per value and one line per vector, vectors and results can be
+ * stored in a packed binary format:
+ *  - a 24-byte header: the magic "PAV1", the bits per value (1 or 2) in 32 bits, the number of
+ *    values per vector in 64 bits and the number of vectors in 64 bits, all little-endian;
+ *  - the vectors, each starting on a byte boundary, with value i in bits [i * b, (i + 1) * b) from
+ *    the least significant bit of the first byte. With 2 bits per value 0b00 is 0, 0b01 is 1 and
+ *    0b10 is X; files without X values use 1 bit per value.
+ */
+namespace vectorio {
+	enum class Format { TEXT, BINARY };
+
+	// The contents of a file, mapped in memory. Files that can't be mapped (eg. pipes) are read
+	// into memory instead.
+	class MappedFile {
+		const char *data = nullptr;
+		size_t size = 0;
+		bool mapped = false;
+		std::string fallback;
+
+	  public:
+		explicit MappedFile(const std::string &path);
+		~MappedFile();
+		MappedFile(const MappedFile &) = delete;
+		MappedFile &operator=(const MappedFile &) = delete;
+
+		std::string_view contents() const { return {data, size}; }
+	};
+
+	// A vector in either format, decoded on access. In text, 'x' and 'X' are X, and any other
+	// character but '0' is 1.
+	class Vector {
+		const char *data = nullptr;
+		size_t width = 0;
+		unsigned bits = 0; // Per value, or 0 for text
+
+	  public:
+		Vector() = default;
+		Vector(const char *data, size_t width, unsigned bits)
+		    : data(data), width(width), bits(bits) {}
+
+		size_t size() const { return width; }
+		// The encoded values; equal bytes mean equal vectors
+		std::string_view bytes() const { return {data, bits ? (bits * width + 7) / 8 : width}; }
+		TruthValue operator[](size_t i) const {
+			if (bits == 0) {
+				if (data[i] == 'x' || data[i] == 'X')
+					return TruthValue::X;
+				return data[i] != '0';
+			}
+			if (bits == 1)
+				return bool((uint8_t(data[i / 8]) >> (i % 8)) & 1);
+			switch ((uint8_t(data[i / 4]) >> (2 * (i % 4))) & 3) {
+				case 0:
+					return TruthValue::FALSE;
+				case 1:
+					return TruthValue::TRUE;
+				default:
+					return TruthValue::X;
+			}
+		}
+	};
+
+	// Splits a buffer into vectors, detecting the format from the header. Text is split into lines
+	// like std::getline.
+	class VectorReader {
+		std::string_view contents, remaining;
+		Format _format = Format::TEXT;
+		size_t width = 0;
+		unsigned bits = 0;
+		size_t stride = 0;
+		uint64_t count = 0, left = 0; // Vectors, in binary files
+
+	  public:
+		explicit VectorReader(std::string_view contents);
+
+		Format format() const { return _format; }
+
+		// Where the next vector starts in the buffer
+		size_t offset() const { return remaining.data() - contents.data(); }
+		// Continues from an offset returned by offset() after reading `vectors` vectors
+		void seek(size_t offset, uint64_t vectors);
+
+		// The vector is valid as long as the buffer is. Returns false at the end of the buffer.
+		bool next(Vector &vector) {
+			if (_format == Format::BINARY) {
+				// Vectors may take no space, so only the count says where the file ends
+				if (left == 0)
+					return false;
+				left--;
+				vector = Vector(remaining.data(), width, bits);
+				remaining.remove_prefix(stride);
+				return true;
+			}
+			if (remaining.empty())
+				return false;
+			size_t end = remaining.find('\n');
+			std::string_view line = remaining.substr(0, end);
+			vector = Vector(line.data(), line.size(), 0);
+			remaining.remove_prefix(end == std::string_view::npos ? remaining.size() : end + 1);
+			return true;
+		}
+	};
+
+	/* Writes the results of the simulation. Text is written whenever `CAPACITY` bytes are buffered.
+	 * Binary files need the vector count and the absence of X values in the header, so they are
+	 * buffered with 2 bits per value and written at the end. Both happen on destruction as well, so
+	 * output that precedes an error is not lost.
+	 *
+	 * Results are first encoded into a row buffer, so that threads can encode them independently
+	 * and append them in order.
+	 */
+	class ResultWriter {
+		static constexpr size_t CAPACITY = 1 << 20;
+
+		std::ostream &out;
+		Format format;
+		size_t width;
+		std::string buffer;
+		uint64_t count = 0;
+		bool finished = false;
+
+	  public:
+		ResultWriter(std::ostream &out, Format format, size_t width);
+		~ResultWriter() { finish(); }
+		ResultWriter(const ResultWriter &) = delete;
+		ResultWriter &operator=(const ResultWriter &) = delete;
+
+		// Appends a vector of `width` values to `rows`
+		template <class Values>
+		void encode(std::string &rows, const Values &values) const {
+			STATS_TIME(OUTPUT);
+			if (format == Format::TEXT) {
+				for (size_t i = 0; i < width; i++)
+					rows += values[i].toChar();
+				rows += '\n';
+				return;
+			}
+			size_t first = rows.size();
+			rows.resize(first + (2 * width + 7) / 8);
+			for (size_t i = 0; i < width; i++) {
+				TruthValue value = values[i];
+				uint8_t code = value == TruthValue::X ? 2 : value == TruthValue::TRUE;
+				rows[first + i / 4] |= char(code << (2 * (i % 4)));
+			}
+		}
+
+		// Writes `count` vectors encoded by `encode`
+		void write(std::string_view rows, uint64_t count);
+		// Writes what is buffered, if the format allows it
+		void flush();
+		// Writes everything; nothing can be written afterwards
+		void finish();
+	};
+
+	// Converts a file of vectors or results between text and binary, in the other format than
+	// `contents`. Binary files use 1 bit per value if they have no X values.
+	std::string convert(std::string_view contents);
+} // namespace vectorio
@@ -0,0 +1,24 @@
+#include "utils.h"
+#include "vectorio.h"
+#include <fstream>
+#include <iostream>
+
+// Converts a file of vectors or results from text to binary, or from binary to text
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		std::cerr << "Syntax: " << argv[0] << " <input file> <output file>" << std::endl;
+		return 1;
+	}
+
+	try {
+		vectorio::MappedFile input(argv[1]);
+		std::string output = vectorio::convert(input.contents());
+		std::ofstream file(argv[2], std::ios::out | std::ios::binary);
+		if (file.fail())
+			throw "Failed to open file."s;
+		file << output;
+	} catch (std::string &e) {
+		std::cerr << "An error occurred while converting " << argv[1] << ": " << e << std::endl;
+		return 1;
+	}
+}